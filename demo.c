@@ -1,7 +1,8 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -9,123 +10,118 @@
 #include "mathc/mathc.h"
 
 #include "sdf.h"
+#include "sdfvm.h"
+#include "sdfblend.h"
+#include "sdfrender.h"
+#include "sdfcmd.h"
+#include "sdfshape.h"
+#include "sdfwrite.h"
+#include "sdfsprite.h"
 
 /* global feathering amount for hacky anti-aliasing */
 #define FEATHER_AMT 0.03
 
-typedef struct {
-    struct vec2 iResolution;
-    void *ud;
-    struct vec4 *region;
-} image_data;
+/* subsamples per pixel side at edges, 1 for none */
+#define AA_SAMPLES 1
+
+/* pixel format of the canvases, see sdfblend.h */
+#define CANVAS_FORMAT SDFBLEND_RGBF
+
+/* images named .png are written as png at this level, see sdfwrite.h */
+#define PNG_LEVEL SDFWRITE_FAST
+
+/* rows rendered at a time for images drawn in bands */
+#define BAND_ROWS 64
+
+/* draw bands into Z-ordered tiles and linearise them on output */
+#define BAND_TILED 1
+
+/* the sprinkles blit cached masks, kept to this many bytes.
+ * 0 draws every one.
+ */
+#define SPRITE_BYTES (4 << 20)
+
+/* sprite offset buckets and size steps per pixel, see sdfsprite.h */
+#define SPRITE_SUBPIXEL 2
+#define SPRITE_SIZESTEPS 1
 
 struct canvas {
-    struct vec3 *buf;
+    void *buf;
+    int format;
     struct vec2 res;
-};
+    sdfrender *r;
 
-#define US_MAXTHREADS 8
+    /* when set, draws are recorded here instead */
+    sdfcmd *cmd;
 
-typedef struct {
-    struct vec3 *buf;
-    image_data *data;
-    int off;
-    void (*draw)(struct vec3 *, struct vec2, image_data *);
-    int stride;
-} thread_data;
+    /* when set, draws become blits of cached masks */
+    sdfsprite *sprites;
+};
 
-void *draw_thread(void *arg)
+/* shape, if not -1, is the sdfshape id whose bounds for params
+ * clip the draw
+ */
+void draw_aabb(struct canvas *ctx,
+               struct vec4 region,
+               sdfrender_dist dist,
+               void *ud,
+               size_t udsz,
+               struct vec3 clr,
+               int shape,
+               const void *params)
 {
-    thread_data *td;
-    image_data *data;
-    int x, y;
-    int w, h;
-    int stride;
-    struct vec3 *buf;
-    int nthreads;
-    int xstart, ystart;
-    int xend, yend;
-    int maxpos;
-    struct vec4 *reg;
-
-    td = arg;
-    data = td->data;
-    buf = td->buf;
-
-    w = data->iResolution.x;
-    h = data->iResolution.y;
-    stride = td->stride;
-    reg = data->region;
-
-    ystart = td->off + reg->y;
-    xstart = reg->x;
-    xend = reg->z + reg->x;
-    yend = reg->w + reg->y;
-
-    /* This is hard-coded for now */
-    nthreads = US_MAXTHREADS;
-
-    maxpos = w * h;
-
-    for (y = ystart; y < yend; y+=nthreads) {
-        for (x = xstart; x < xend; x++) {
-            int pos;
-            struct vec3 *c;
-            pos = y*stride + x;
-
-            if (pos > maxpos || pos < 0) continue;
-            c = &buf[pos];
-            td->draw(c, svec2(x - reg->x, y - reg->y), data);
-        }
-    }
+    sdfrender_draw dr;
+    struct vec2 lo, hi;
+
+    sdfrender_draw_init(&dr);
+    dr.buf = ctx->buf;
+    dr.format = ctx->format;
+    dr.width = ctx->res.x;
+    dr.height = ctx->res.y;
+    dr.stride = ctx->res.x;
+    dr.region = region;
+    dr.dist = dist;
+    dr.ud = ud;
+    dr.clr = clr;
+    dr.feather = FEATHER_AMT;
+
+    /* the shapes are exact distances of the normalized point,
+     * which spans 2 units over the region height
+     */
+    dr.scale = 2 / region.w;
+    dr.lipschitz = 1;
+    dr.samples = AA_SAMPLES;
 
-    return NULL;
-}
+    if (shape >= 0 && !sdfshape_aabb(shape, params, &lo, &hi)) {
+        sdfrender_draw_aabb(&dr, lo, hi);
+    }
 
-void draw_with_stride(struct vec3 *buf,
-                      struct vec2 res,
-                      struct vec4 region,
-                      void (*drawfunc)(struct vec3 *, struct vec2, image_data *),
-                      void *ud,
-                      int stride)
-{
-    thread_data td[US_MAXTHREADS];
-    pthread_t thread[US_MAXTHREADS];
-    int t;
-    image_data data;
-
-    data.iResolution = res;
-    data.ud = ud;
-    data.region = &region;
-
-    for (t = 0; t < US_MAXTHREADS; t++) {
-        td[t].buf = buf;
-        td[t].data = &data;
-        td[t].off = t;
-        td[t].draw = drawfunc;
-        td[t].stride = stride;
-        pthread_create(&thread[t], NULL, draw_thread, &td[t]);
+    /* the user data of every shape here is floats, and
+     * they are what tells two sprites of a shape apart
+     */
+    if (ctx->sprites != NULL) {
+        sdfrender_draw sp;
+        sdfsprite_draw(ctx->sprites, ctx->r, &dr,
+                       ud, udsz / sizeof(float), &sp);
+        dr = sp;
     }
 
-    for (t = 0; t < US_MAXTHREADS; t++) {
-        pthread_join(thread[t], NULL);
+    if (ctx->cmd != NULL) {
+        sdfcmd_draw(ctx->cmd, &dr, ud, udsz);
+        return;
     }
-}
 
-void draw(struct vec3 *buf,
-          struct vec2 res,
-          struct vec4 region,
-          void (*drawfunc)(struct vec3 *, struct vec2, image_data *),
-          void *ud)
-{
-    draw_with_stride(buf, res, region, drawfunc, ud, res.x);
+    sdfrender_run(ctx->r, &dr);
 }
 
-static float smoothstep(float e0, float e1, float x)
+void draw(struct canvas *ctx,
+          struct vec4 region,
+          sdfrender_dist dist,
+          void *ud,
+          size_t udsz,
+          struct vec3 clr)
 {
-    float t;
-    t = clampf((x - e0) / (e1 - e0), 0.0, 1.0);
-    return t * t * (3.0 - 2.0 * t);
+    draw_aabb(ctx, region, dist, ud, udsz, clr, -1, NULL);
 }
 
 struct vec3 rgb2color(int r, int g, int b)
@@ -134,65 +130,116 @@ struct vec3 rgb2color(int r, int g, int b)
     return svec3(r * scale, g * scale, b * scale);
 }
 
-static int mkcolor(float x)
+static void fill(struct canvas *ctx, struct vec3 clr)
 {
-    return floor(x * 255);
+    sdfblend_fill_format(ctx->buf, ctx->format,
+                         ctx->res.x * ctx->res.y, clr);
 }
 
-static float feather(float d, float amt)
+/* png or ppm, by the file extension */
+static int begin_image(sdfwrite *wr, const char *filename, struct vec2 res)
 {
-    float alpha;
-    alpha = 0;
-    alpha = sdf_sign(d) > 0;
-    alpha += smoothstep(amt, 0.0, fabs(d));
-    alpha = clampf(alpha, 0, 1);
-    return alpha;
+    size_t len;
+
+    len = strlen(filename);
+    if (len > 4 && !strcmp(filename + len - 4, ".png")) {
+        return sdfwrite_begin_png(wr, filename, res.x, res.y, PNG_LEVEL);
+    }
+
+    return sdfwrite_begin(wr, filename, res.x, res.y);
 }
 
-static void d_fill(struct vec3 *fragColor,
-                   struct vec2 fragCoord,
-                   image_data *id)
+static int write_image(void *buf,
+                       int format,
+                       struct vec2 res,
+                       const char *filename)
 {
+    sdfwrite *wr;
+    int rc;
+
+    wr = malloc(sdfwrite_sizeof());
+    rc = begin_image(wr, filename, res);
+    if (rc == SDFWRITE_OK) {
+        sdfwrite_rows(wr, buf, format, res.x, res.y);
+        rc = sdfwrite_end(wr);
+    }
+    free(wr);
 
-    struct vec3 *col;
+    if (rc) fprintf(stderr, "could not write %s\n", filename);
 
-    col = id->ud;
-    *fragColor = *col;
+    return rc;
 }
 
-static void fill(struct canvas *ctx, struct vec3 clr)
-{
-    draw(ctx->buf, ctx->res, 
-         svec4(0, 0, ctx->res.x, ctx->res.y), 
-         d_fill, &clr);
-}
+struct band_out {
+    sdfwrite *wr;
+    int format;
+    int width;
+
+    /* set when the band is tiled, rows linearises it */
+    const sdfblend_tiles *tiles;
+    void *rows;
+};
 
-static void write_ppm(struct vec3 *buf,
-                      struct vec2 res,
-                      const char *filename)
+static int write_band(void *ud, const void *buf, int y, int nrows)
 {
-    int x, y;
-    FILE *fp;
-    unsigned char *ibuf;
+    struct band_out *out;
+    out = ud;
 
-    fp = fopen(filename, "w");
-    fprintf(fp, "P6\n%d %d\n%d\n", (int)res.x, (int)res.y, 255);
+    if (out->tiles != NULL) {
+        sdfblend_tiles_rows(out->tiles, 0, nrows, out->rows, out->width);
+        buf = out->rows;
+    }
 
-    ibuf = malloc(3 * res.y * res.x * sizeof(unsigned char));
-    for (y = 0; y < res.y; y++) {
-        for (x = 0; x < res.x; x++) {
-            int pos;
-            pos = y * res.x + x;
+    return sdfwrite_rows(out->wr, buf, out->format, out->width, nrows);
+}
 
-            ibuf[3*pos] = mkcolor(buf[pos].x);
-            ibuf[3*pos + 1] = mkcolor(buf[pos].y);
-            ibuf[3*pos + 2] = mkcolor(buf[pos].z);
+/* render a command list a band at a time, writing each out */
+static int render_image(sdfcmd *cmd,
+                        sdfrender *r,
+                        int format,
+                        struct vec2 res,
+                        struct vec3 bg,
+                        const char *filename)
+{
+    struct band_out out;
+    sdfblend_tiles tiles;
+    void *band;
+    int bandfmt;
+    int rc;
+
+    band = malloc(res.x * BAND_ROWS * sdfblend_pixsize(format));
+    out.wr = malloc(sdfwrite_sizeof());
+    out.format = format;
+    out.width = res.x;
+    out.tiles = NULL;
+    out.rows = band;
+    bandfmt = format;
+
+    if (BAND_TILED &&
+        !sdfblend_tiles_init(&tiles, res.x, BAND_ROWS,
+                             format, SDFBLEND_TILE_MORTON)) {
+        out.tiles = &tiles;
+        band = &tiles;
+        bandfmt = SDFBLEND_TILED;
+    }
+
+    rc = begin_image(out.wr, filename, res);
+    if (rc == SDFWRITE_OK) {
+        if (sdfcmd_render_bands(cmd, r, band, bandfmt,
+                                res.x, res.y, res.x, BAND_ROWS,
+                                bg, write_band, &out)) {
+            rc = SDFWRITE_NOT_OK;
         }
+        if (sdfwrite_end(out.wr) && rc == SDFWRITE_OK) rc = SDFWRITE_IO;
     }
 
-    fwrite(ibuf, 3 * res.y * res.x * sizeof(unsigned char), 1, fp);
-    free(ibuf);
-    fclose(fp);
+    free(out.wr);
+    free(out.rows);
+    if (out.tiles != NULL) sdfblend_tiles_clean(&tiles);
+
+    if (rc) fprintf(stderr, "could not write %s\n", filename);
+
+    return rc;
 }
 
 void draw_gridlines(struct canvas *ctx)
@@ -207,45 +254,35 @@ void draw_gridlines(struct canvas *ctx)
     size = w / 4;
 
     for (y = 0; y < h; y += size) {
-        for (x = 0; x < w; x++) {
-            int pos;
-            pos = y*w + x;
-            ctx->buf[pos] = svec3_zero();
-        }
+        sdfblend_fill_format(sdfblend_pixel(ctx->buf, ctx->format, y*w),
+                             ctx->format, w, svec3_zero());
     }
 
     for (x = 0; x < w; x += size) {
         for (y = 0; y < h; y++) {
-            int pos;
-            pos = y*w + x;
-            ctx->buf[pos] = svec3_zero();
+            void *px;
+            px = sdfblend_pixel(ctx->buf, ctx->format, y*w + x);
+            sdfblend_fill_format(px, ctx->format, 1, svec3_zero());
         }
     }
 
 }
 
 
-static void d_heart(struct vec3 *fragColor,
-                    struct vec2 fragCoord,
-                    image_data *id)
+static float d_heart(struct vec2 fragCoord,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
     p = sdf_heart_center(fragCoord, res);
 
-    d = -sdf_heart(p);
+    d = sdf_heart(p);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void heart(struct canvas *ctx,
@@ -253,30 +290,23 @@ void heart(struct canvas *ctx,
            float w, float h,
            struct vec3 clr)
 {
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_heart, &clr);
+    draw(ctx, svec4(x, y, w, h), d_heart, NULL, 0, clr);
 }
 
-static void d_circ(struct vec3 *fragColor,
-                   struct vec2 st,
-                   image_data *id)
+static float d_circ(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_circle(p, 0.9);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_circle(p, 0.9);
 
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void circle(struct canvas *ctx,
@@ -288,36 +318,30 @@ void circle(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_circ, &clr);
+    draw(ctx, svec4(x, y, w, h), d_circ, NULL, 0, clr);
 }
 
 struct rounded_box_data {
     struct vec2 b;
     struct vec4 r;
-    struct vec3 clr;
 };
 
-static void d_rounded_box(struct vec3 *fragColor,
-                          struct vec2 st,
-                          image_data *id)
+static float d_rounded_box(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct rounded_box_data *rb;
 
-    res = svec2(id->region->z, id->region->w);
-    rb = (struct rounded_box_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    rb = (struct rounded_box_data *)dr->ud;
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_rounded_box(p, rb->b, rb->r);
+    d = sdf_rounded_box(p, rb->b, rb->r);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    col = svec3_lerp(*fragColor, rb->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void rounded_box(struct canvas *ctx,
@@ -329,37 +353,30 @@ void rounded_box(struct canvas *ctx,
      * has to do with truncation? 
      */
     rb.b = svec2(0.9, 0.9);
-    rb.clr = clr;
     rb.r = svec4(r, r, r, r);
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_rounded_box, &rb);
+    draw(ctx, svec4(x, y, w, h), d_rounded_box, &rb, sizeof(rb), clr);
 }
 
 struct box_data {
     struct vec2 b;
-    struct vec3 clr;
 };
 
-static void d_box(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_box(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct box_data *bb;
 
-    res = svec2(id->region->z, id->region->w);
-    bb = (struct box_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    bb = (struct box_data *)dr->ud;
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_box(p, bb->b);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_box(p, bb->b);
 
-    col = svec3_lerp(*fragColor, bb->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void box(struct canvas *ctx,
@@ -371,36 +388,29 @@ void box(struct canvas *ctx,
      * has to do with truncation? 
      */
     bb.b = svec2(0.9, 0.9);
-    bb.clr = clr;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_box, &bb);
+    draw(ctx, svec4(x, y, w, h), d_box, &bb, sizeof(bb), clr);
 }
 
 struct rhombus_data {
     struct vec2 b;
-    struct vec3 clr;
 };
 
-static void d_rhombus(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_rhombus(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct rhombus_data *rh;
 
-    res = svec2(id->region->z, id->region->w);
-    rh = (struct rhombus_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    rh = (struct rhombus_data *)dr->ud;
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_rhombus(p, rh->b);
+    d = sdf_rhombus(p, rh->b);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    col = svec3_lerp(*fragColor, rh->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void rhombus(struct canvas *ctx,
@@ -414,44 +424,31 @@ void rhombus(struct canvas *ctx,
     w = 2 * r;
     h = w;
     rh.b = svec2(0.9, 0.9);
-    rh.clr = clr;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_rhombus, &rh);
+    draw(ctx, svec4(x, y, w, h), d_rhombus, &rh, sizeof(rh), clr);
 }
 
-struct triangle_equilateral_data {
-    struct vec3 clr;
-};
-
-static void d_triangle_equilateral(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_triangle_equilateral(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
-    struct triangle_equilateral_data *rh;
 
-    res = svec2(id->region->z, id->region->w);
-    rh = (struct triangle_equilateral_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
     /* horizontal flip */
     p.y = 1 - p.y;
-    d = -sdf_equilateral_triangle(p);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_equilateral_triangle(p);
 
-    col = svec3_lerp(*fragColor, rh->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void triangle_equilateral(struct canvas *ctx,
          float cx, float cy, float r,
          struct vec3 clr)
 {
-    struct triangle_equilateral_data tri;
     float x, y, w, h;
     float rad;
 
@@ -466,31 +463,23 @@ void triangle_equilateral(struct canvas *ctx,
     x = cx - w*0.5;
     y = cy - r;
 
-    tri.clr = clr;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_triangle_equilateral, &tri);
+    draw(ctx, svec4(x, y, w, h), d_triangle_equilateral, NULL, 0, clr);
 }
 
-static void d_pentagon(struct vec3 *fragColor,
-                       struct vec2 st,
-                       image_data *id)
+static float d_pentagon(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_pentagon(p, 0.8);
+    d = sdf_pentagon(p, 0.8);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void pentagon(struct canvas *ctx,
@@ -502,30 +491,23 @@ void pentagon(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_pentagon, &clr);
+    draw(ctx, svec4(x, y, w, h), d_pentagon, NULL, 0, clr);
 }
 
-static void d_hexagon(struct vec3 *fragColor,
-                       struct vec2 st,
-                       image_data *id)
+static float d_hexagon(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_hexagon(p, 0.8);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_hexagon(p, 0.8);
 
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void hexagon(struct canvas *ctx,
@@ -537,30 +519,23 @@ void hexagon(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_hexagon, &clr);
+    draw(ctx, svec4(x, y, w, h), d_hexagon, NULL, 0, clr);
 }
 
-static void d_octogon(struct vec3 *fragColor,
-                      struct vec2 st,
-                      image_data *id)
+static float d_octogon(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_octogon(p, 0.8);
+    d = sdf_octogon(p, 0.8);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void octogon(struct canvas *ctx,
@@ -572,30 +547,23 @@ void octogon(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_octogon, &clr);
+    draw(ctx, svec4(x, y, w, h), d_octogon, NULL, 0, clr);
 }
 
-static void d_hexagram(struct vec3 *fragColor,
-                       struct vec2 st,
-                       image_data *id)
+static float d_hexagram(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
     d = sdf_hexagram(p, 0.5);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void hexagram(struct canvas *ctx,
@@ -607,36 +575,30 @@ void hexagram(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_hexagram, &clr);
+    draw(ctx, svec4(x, y, w, h), d_hexagram, NULL, 0, clr);
 }
 struct star5_data {
-    struct vec3 clr;
     float rf;
 };
 
-static void d_star5(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_star5(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct star5_data *star;
 
-    res = svec2(id->region->z, id->region->w);
-    star = (struct star5_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    star = (struct star5_data *)dr->ud;
 
     /* flip so the start is pointing upwards */
     st.y = res.y - st.y;
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_star5(p, 0.9, star->rf);
+    d = sdf_star5(p, 0.9, star->rf);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    col = svec3_lerp(*fragColor, star->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void star5(struct canvas *ctx,
@@ -652,39 +614,32 @@ void star5(struct canvas *ctx,
     x = cx - r;
     y = cy - r;
 
-    star.clr = clr;
     star.rf = rf;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_star5, &star);
+    draw(ctx, svec4(x, y, w, h), d_star5, &star, sizeof(star), clr);
 }
 
 struct rounded_x_data {
-    struct vec3 clr;
     float r;
 };
 
-static void d_rounded_x(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_rounded_x(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct rounded_x_data *rx;
 
-    res = svec2(id->region->z, id->region->w);
-    rx = (struct rounded_x_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    rx = (struct rounded_x_data *)dr->ud;
 
     /* flip so the start is pointing upwards */
     st.y = res.y - st.y;
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_rounded_x(p, 0.9, rx->r);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_rounded_x(p, 0.9, rx->r);
 
-    col = svec3_lerp(*fragColor, rx->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void rounded_x(struct canvas *ctx,
@@ -699,32 +654,24 @@ void rounded_x(struct canvas *ctx,
     x = cx - r;
     y = cy - r;
 
-    rx.clr = clr;
     rx.r = thickness;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_rounded_x, &rx);
+    draw(ctx, svec4(x, y, w, h), d_rounded_x, &rx, sizeof(rx), clr);
 }
 
-static void d_vesica(struct vec3 *fragColor,
-                      struct vec2 st,
-                      image_data *id)
+static float d_vesica(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_vesica(p, 0.9, 0.5);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_vesica(p, 0.9, 0.5);
 
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void vesica(struct canvas *ctx,
@@ -732,36 +679,33 @@ void vesica(struct canvas *ctx,
              struct vec3 clr)
 {
     float x, y, w, h;
+    struct sdfshape_vesica shape;
     x = cx - r;
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_vesica, &clr);
+    shape.r = 0.9;
+    shape.d = 0.5;
+    draw_aabb(ctx, svec4(x, y, w, h), d_vesica, NULL, 0, clr,
+              SDFSHAPE_VESICA, &shape);
 }
 
-static void d_egg(struct vec3 *fragColor,
-                      struct vec2 st,
-                      image_data *id)
+static float d_egg(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    struct vec3 *fg;
-    float alpha;
     struct vec2 res;
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
 
     st.y = res.y - st.y;
     p = sdf_normalize(svec2(st.x, st.y), res);
     p = svec2_add(p, svec2(0, 0.2));
-    d = -sdf_egg(p, 0.6, 0.3);
+    d = sdf_egg(p, 0.6, 0.3);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    fg = (struct vec3 *)id->ud;
-    col = svec3_lerp(*fragColor, *fg, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void egg(struct canvas *ctx,
@@ -773,38 +717,32 @@ void egg(struct canvas *ctx,
     y = cy - r;
     w = r * 2;
     h = w;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_egg, &clr);
+    draw(ctx, svec4(x, y, w, h), d_egg, NULL, 0, clr);
 }
 
 struct ellipse_data {
-    struct vec3 clr;
     float a;
     float b;
 };
 
-static void d_ellipse(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_ellipse(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct vec2 ab;
     struct ellipse_data *el;
 
-    res = svec2(id->region->z, id->region->w);
-    el = (struct ellipse_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    el = (struct ellipse_data *)dr->ud;
 
     p = sdf_normalize(svec2(st.x, st.y), res);
     ab = svec2(el->a, el->b);
-    d = -sdf_ellipse(p, ab);
-
-    alpha = feather(d, FEATHER_AMT);
+    d = sdf_ellipse(p, ab);
 
-    col = svec3_lerp(*fragColor, el->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void ellipse(struct canvas *ctx,
@@ -812,6 +750,7 @@ void ellipse(struct canvas *ctx,
            struct vec3 clr)
 {
     struct ellipse_data el;
+    struct sdfshape_ellipse shape;
     float x, y, w, h;
 
 
@@ -820,40 +759,35 @@ void ellipse(struct canvas *ctx,
     x = cx - r;
     y = cy - r;
 
-    el.clr = clr;
     el.a = a;
     el.b = b;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_ellipse, &el);
+    shape.ab = svec2(a, b);
+    draw_aabb(ctx, svec4(x, y, w, h), d_ellipse, &el, sizeof(el), clr,
+              SDFSHAPE_ELLIPSE, &shape);
 }
 
 struct moon_data {
-    struct vec3 clr;
     float d;
     float ra;
     float rb;
 };
 
-static void d_moon(struct vec3 *fragColor,
-                  struct vec2 st,
-                  image_data *id)
+static float d_moon(struct vec2 st,
+                  const sdfrender_draw *dr,
+                  sdfrender_worker *w)
 {
     struct vec2 p;
     float d;
-    struct vec3 col;
-    float alpha;
     struct vec2 res;
     struct moon_data *moon;
 
-    res = svec2(id->region->z, id->region->w);
-    moon = (struct moon_data *)id->ud;
+    res = svec2(dr->region.z, dr->region.w);
+    moon = (struct moon_data *)dr->ud;
 
     p = sdf_normalize(svec2(st.x, st.y), res);
-    d = -sdf_moon(p, moon->d, moon->ra, moon->rb);
+    d = sdf_moon(p, moon->d, moon->ra, moon->rb);
 
-    alpha = feather(d, FEATHER_AMT);
-
-    col = svec3_lerp(*fragColor, moon->clr, alpha);
-    *fragColor = col;
+    return d;
 }
 
 void moon(struct canvas *ctx,
@@ -862,6 +796,7 @@ void moon(struct canvas *ctx,
            struct vec3 clr)
 {
     struct moon_data mn;
+    struct sdfshape_moon shape;
     float x, y, w, h;
 
 
@@ -870,23 +805,27 @@ void moon(struct canvas *ctx,
     x = cx - r;
     y = cy - r;
 
-    mn.clr = clr;
     mn.ra = ra;
     mn.rb = rb;
     mn.d = d;
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_moon, &mn);
+    shape.d = d;
+    shape.ra = ra;
+    shape.rb = rb;
+    draw_aabb(ctx, svec4(x, y, w, h), d_moon, &mn, sizeof(mn), clr,
+              SDFSHAPE_MOON, &shape);
 }
 
 #define NSPRINKLES 700
 
-void sprinkles(struct canvas *ctx, struct vec3 *rainbow)
+/* clear the canvas, then record the sprinkles into cmd */
+void sprinkles(struct canvas *ctx, struct vec3 *rainbow, sdfcmd *cmd)
 {
     int i;
     float sz;
     int clrpos;
     float w, h;
 
-    fill(ctx, svec3(1.0, 1.0, 1.0));
+    ctx->cmd = cmd;
 
     clrpos = 0;
     sz = 10;
@@ -966,12 +905,12 @@ void sprinkles(struct canvas *ctx, struct vec3 *rainbow)
         clrpos = (clrpos + 1) % 5;
     }
 
-    write_ppm(ctx->buf, ctx->res, "sprinkles.ppm");
+    ctx->cmd = NULL;
 }
 
 int main(int argc, char *argv[])
 {
-    struct vec3 *buf;
+    void *buf;
     int width, height;
     struct vec2 res;
     struct canvas ctx;
@@ -980,6 +919,7 @@ int main(int argc, char *argv[])
     int sz_scaled;
     struct vec3 rainbow[5];
     int clrpos;
+    sdfcmd *cmd;
 
     /* rainbow colors:
      * Red: 255, 179, 186
@@ -1012,10 +952,18 @@ int main(int argc, char *argv[])
 
     res = svec2(width, height);
 
-    buf = malloc(width * height * sizeof(struct vec3));
+    buf = malloc(width * height * sdfblend_pixsize(CANVAS_FORMAT));
 
     ctx.res = res;
     ctx.buf = buf;
+    ctx.format = CANVAS_FORMAT;
+    ctx.cmd = NULL;
+    ctx.sprites = NULL;
+    ctx.r = malloc(sdfrender_sizeof());
+    if (sdfrender_init(ctx.r, SDFRENDER_AUTO, SDFRENDER_PIN)) {
+        fprintf(stderr, "could not start render threads\n");
+        return 1;
+    }
 
     fill(&ctx, svec3(1., 1.0, 1.0));
     heart(&ctx, 0, 0, sz, sz, rainbow[clrpos]);
@@ -1121,10 +1069,48 @@ int main(int argc, char *argv[])
     draw_gridlines(&ctx);
 #endif
 
-    write_ppm(buf, res, "demo.ppm");
+#ifdef PRINT_RENDER_STATS
+    sdfrender_stats_print(ctx.r, stderr);
+    sdfrender_stats_reset(ctx.r);
+#endif
+
+    write_image(buf, CANVAS_FORMAT, res, "demo.ppm");
 
-    sprinkles(&ctx, rainbow);
+    /* The sprinkles are one command list, drawn and written
+     * out a band at a time, without a canvas of their own.
+     */
+    cmd = malloc(sdfcmd_sizeof());
+    sdfcmd_init(cmd);
+
+    if (SPRITE_BYTES > 0) {
+        ctx.sprites = malloc(sdfsprite_sizeof());
+        sdfsprite_init(ctx.sprites, SPRITE_BYTES);
+        sdfsprite_steps(ctx.sprites, SPRITE_SUBPIXEL, SPRITE_SIZESTEPS);
+    }
+
+    sprinkles(&ctx, rainbow, cmd);
+    render_image(cmd, ctx.r, CANVAS_FORMAT, res,
+                 svec3(1.0, 1.0, 1.0), "sprinkles.ppm");
+
+#ifdef PRINT_RENDER_STATS
+    sdfrender_stats_print(ctx.r, stderr);
+    if (ctx.sprites != NULL) {
+        sdfsprite_stats st;
+        sdfsprite_stats_get(ctx.sprites, &st);
+        fprintf(stderr, "sprites: %lu hits, %lu misses, %lu kept, %lu bytes\n",
+                st.hits, st.misses, st.entries, (unsigned long)st.bytes);
+    }
+#endif
+
+    if (ctx.sprites != NULL) {
+        sdfsprite_clean(ctx.sprites);
+        free(ctx.sprites);
+    }
 
+    sdfcmd_clean(cmd);
+    free(cmd);
+    sdfrender_clean(ctx.r);
+    free(ctx.r);
     free(buf);
     return 0;
 }
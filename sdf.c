@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 #include "mathc/mathc.h"
+#include "sdf.h"
 
 float sdf_sign(float x)
 {
@@ -133,17 +134,27 @@ static float ndot(struct vec2 a, struct vec2 b ) {
     return a.x*b.x - a.y*b.y; 
 }
 
-float sdf_rhombus(struct vec2 p, struct vec2 b)
+void sdf_rhombus_prepare(struct sdf_rhombus_prep *rh, struct vec2 b)
+{
+    rh->b = b;
+    rh->inv = 1.0 / svec2_dot(b, b);
+    rh->bxby = b.x*b.y;
+}
+
+float sdf_rhombus_prepared(struct vec2 p, const struct sdf_rhombus_prep *rh)
 {
     float h;
     float d;
     struct vec2 tmp;
+    struct vec2 b;
+
+    b = rh->b;
     /* p = abs(p) */
     p = svec2_abs(p);
     /* h = clamp(ndot(b-2.0*p,b)/dot(b,b), -1.0, 1.0); */
     tmp = svec2_multiply_f(p, 2.0);
     tmp = svec2_subtract(b, tmp);
-    h = ndot(tmp, b) / svec2_dot(b, b);
+    h = ndot(tmp, b) * rh->inv;
     h = clampf(h, -1.0, 1.0);
     /* d = length( p-0.5*b*vec2(1.0-h,1.0+h) ); */
     tmp = svec2_multiply_f(b, 0.5);
@@ -153,12 +164,20 @@ float sdf_rhombus(struct vec2 p, struct vec2 b)
 
     /* return d * sign( p.x*b.y + p.y*b.x - b.x*b.y );  */
 
-    return d * sdf_sign(p.x*b.y + p.y*b.x - b.x*b.y);
+    return d * sdf_sign(p.x*b.y + p.y*b.x - rh->bxby);
+}
+
+float sdf_rhombus(struct vec2 p, struct vec2 b)
+{
+    struct sdf_rhombus_prep rh;
+    sdf_rhombus_prepare(&rh, b);
+    return sdf_rhombus_prepared(p, &rh);
 }
 
 float sdf_equilateral_triangle(struct vec2 p)
 {
-    const float k = sqrt(3.0);
+    /* sqrt(3) */
+    const float k = 1.7320508076;
     p.x = fabs(p.x) - 1.0;
     p.y = p.y + 1.0/k;
     if (p.x + k*p.y > 0.0) {
@@ -288,10 +307,18 @@ float sdf_hexagram(struct vec2 p, float r)
     tmp = svec2(clampf(p.x, r*k.z,r*k.w),r);
     p = svec2_subtract(p, tmp);
 
-    return svec2_length(p) - sdf_sign(p.y);
+    return svec2_length(p) * sdf_sign(p.y);
 }
 
-float sdf_star5(struct vec2 p, float r, float rf)
+void sdf_star5_prepare(struct sdf_star5_prep *s, float r, float rf)
+{
+    /* vec2 ba = rf*vec2(-k1.y,k1.x) - vec2(0,1); */
+    s->r = r;
+    s->ba = svec2(rf*0.587785252292, rf*0.809016994375 - 1.0);
+    s->inv = 1.0 / svec2_dot(s->ba, s->ba);
+}
+
+float sdf_star5_prepared(struct vec2 p, const struct sdf_star5_prep *s)
 {
     const struct vec2 k1 = svec2(0.809016994375, -0.587785252292);
     const struct vec2 k2 = svec2(-k1.x,k1.y);
@@ -316,16 +343,14 @@ float sdf_star5(struct vec2 p, float r, float rf)
     p = svec2_subtract(p, tmp);
 
     p.x = fabs(p.x);
-    p.y -= r;
+    p.y -= s->r;
 
-    /* vec2 ba = rf*vec2(-k1.y,k1.x) - vec2(0,1); */
-    ba = svec2_multiply_f(svec2(-k1.y, k1.x), rf);
-    ba = svec2_subtract(ba, svec2(0, 1));
+    ba = s->ba;
 
     /* float h = clamp( dot(p,ba)/dot(ba,ba), 0.0, r ); */
     tmpf = svec2_dot(p, ba);
-    tmpf = tmpf / svec2_dot(ba, ba);
-    h = clampf(tmpf, 0.0, r);
+    tmpf = tmpf * s->inv;
+    h = clampf(tmpf, 0.0, s->r);
 
     /* return length(p-ba*h) * sign(p.y*ba.x-p.x*ba.y); */
     tmp = svec2_multiply_f(ba, h);
@@ -333,6 +358,13 @@ float sdf_star5(struct vec2 p, float r, float rf)
     return svec2_length(tmp) * sdf_sign(p.y*ba.x-p.x*ba.y);
 }
 
+float sdf_star5(struct vec2 p, float r, float rf)
+{
+    struct sdf_star5_prep s;
+    sdf_star5_prepare(&s, r, rf);
+    return sdf_star5_prepared(p, &s);
+}
+
 float sdf_rounded_x(struct vec2 p, float w, float r)
 {
     p = svec2_abs(p);
@@ -342,30 +374,53 @@ float sdf_rounded_x(struct vec2 p, float w, float r)
     return svec2_length(p) - r;
 }
 
-float sdf_vesica(struct vec2 p, float r, float d)
+void sdf_vesica_prepare(struct sdf_vesica_prep *v, float r, float d)
 {
-    float b;
+    v->r = r;
+    v->d = d;
+    v->b = sqrt(r*r - d*d);
+}
+
+float sdf_vesica_prepared(struct vec2 p, const struct sdf_vesica_prep *v)
+{
+    float b, d;
     float out;
 
     out = 0;
 
     p = svec2_abs(p);
 
-    b = sqrt(r*r - d*d);
+    b = v->b;
+    d = v->d;
 
     if (((p.y - b) * d) > p.x*b) {
         p = svec2_subtract(p, svec2(0.0, b));
         out = svec2_length(p);
     } else {
         p = svec2_subtract(p, svec2(-d, 0.0));
-        out = svec2_length(p) - r;
+        out = svec2_length(p) - v->r;
     }
     return out;
 }
 
-float sdf_egg(struct vec2 p, float ra, float rb)
+float sdf_vesica(struct vec2 p, float r, float d)
 {
-    const float k = sqrt(3.0);
+    struct sdf_vesica_prep v;
+    sdf_vesica_prepare(&v, r, d);
+    return sdf_vesica_prepared(p, &v);
+}
+
+void sdf_egg_prepare(struct sdf_egg_prep *e, float ra, float rb)
+{
+    e->rb = rb;
+    e->r = ra - rb;
+    /* sqrt(3) * r */
+    e->kr = 1.7320508076 * e->r;
+}
+
+float sdf_egg_prepared(struct vec2 p, const struct sdf_egg_prep *e)
+{
+    const float k = 1.7320508076;
     float r;
     float out;
 
@@ -373,7 +428,7 @@ float sdf_egg(struct vec2 p, float ra, float rb)
 
     p.x = fabs(p.x);
 
-    r = ra - rb;
+    r = e->r;
 /*
     return ((p.y<0.0)       ? length(vec2(p.x,  p.y    )) - r :
             (k*(p.x+r)<p.y) ? length(vec2(p.x,  p.y-k*r)) :
@@ -382,19 +437,42 @@ float sdf_egg(struct vec2 p, float ra, float rb)
     if (p.y < 0.0) {
         out = svec2_length(svec2(p.x, p.y)) - r;
     } else {
-        if (k * (p.x + r) < p.y) {
-            out = svec2_length(svec2(p.x, p.y-k*r));
+        if (k*p.x + e->kr < p.y) {
+            out = svec2_length(svec2(p.x, p.y - e->kr));
         } else {
             out = svec2_length(svec2(p.x + r, p.y)) - 2.0*r;
         }
     }
 
-    return out - rb;
+    return out - e->rb;
 }
 
-float sdf_ellipse(struct vec2 p, struct vec2 ab)
+float sdf_egg(struct vec2 p, float ra, float rb)
+{
+    struct sdf_egg_prep e;
+    sdf_egg_prepare(&e, ra, rb);
+    return sdf_egg_prepared(p, &e);
+}
+
+void sdf_ellipse_prepare(struct sdf_ellipse_prep *e, struct vec2 ab)
 {
     float l;
+
+    e->ab = ab;
+    l = ab.y*ab.y - ab.x*ab.x;
+
+    if (l != 0) {
+        e->il = 1.0 / l;
+    } else {
+        e->il = 0;
+        printf("l is zero\n");
+    }
+}
+
+float sdf_ellipse_prepared(struct vec2 p, const struct sdf_ellipse_prep *e)
+{
+    float il;
+    struct vec2 ab;
     float m, m2;
     float n, n2;
     float c, c3;
@@ -406,32 +484,28 @@ float sdf_ellipse(struct vec2 p, struct vec2 ab)
     struct vec2 r;
 
     if (p.x == 0 && p.y == 0) {
-        /* hack to prevent dot, hopefully */
-        return 1.0;
+        /* the solve below breaks down at the centre, which is
+         * the shorter semi-axis inside
+         */
+        return -sdf_min(e->ab.x, e->ab.y);
     }
 
     p = svec2_abs(p);
 
+    ab = e->ab;
+    il = e->il;
 
+    /* swapping the axes flips the sign of l */
     if (p.x > p.y) {
         p = svec2(p.y, p.x);
         ab = svec2(ab.y, ab.x);
+        il = -il;
     }
 
-    l = ab.y*ab.y - ab.x*ab.x;
-    if (l != 0) {
-        m = ab.x*p.x / l;
-    } else {
-        m = 0;
-        printf("l is zero\n");
-    }
+    m = ab.x*p.x*il;
     m2 = m*m;
 
-    if (l != 0) {
-        n = ab.y*p.y / l;
-    } else {
-        n = 0;
-    }
+    n = ab.y*p.y*il;
     n2 = n*n;
     c = (m2 + n2 - 1.0) / 3.0;
     c3 = c*c*c;
@@ -448,10 +522,10 @@ float sdf_ellipse(struct vec2 p, struct vec2 ab)
 
         h = acos(q/c3)/3.0;
         s = cos(h);
-        t = sin(h)*sqrt(3.0);
+        t = sin(h)*1.7320508076;
         rx = sqrt(-c*(s + t + 2.0) + m2);
         ry = sqrt(-c*(s - t + 2.0) + m2);
-        co = (ry + sdf_sign(l)*rx + fabs(g)/(rx*ry) - m)*0.5;
+        co = (ry + sdf_sign(il)*rx + fabs(g)/(rx*ry) - m)*0.5;
     } else {
         float h;
         float s;
@@ -464,7 +538,7 @@ float sdf_ellipse(struct vec2 p, struct vec2 ab)
         s = sdf_sign(q+h)*pow(fabs(q+h), 1.0/3.0);
         u = sdf_sign(q-h)*pow(fabs(q-h), 1.0/3.0);
         rx = -s - u - c*4.0 + 2.0*m2;
-        ry = (s - u)*sqrt(3.0);
+        ry = (s - u)*1.7320508076;
         rm = sqrt(rx*rx + ry*ry);
         co = (ry/sqrt(rm - rx) + 2.0*g/rm - m)*0.5;
     }
@@ -478,29 +552,52 @@ float sdf_ellipse(struct vec2 p, struct vec2 ab)
     return out;
 }
 
-float sdf_moon(struct vec2 p, float d, float ra, float rb)
+float sdf_ellipse(struct vec2 p, struct vec2 ab)
+{
+    struct sdf_ellipse_prep e;
+    sdf_ellipse_prepare(&e, ab);
+    return sdf_ellipse_prepared(p, &e);
+}
+
+void sdf_moon_prepare(struct sdf_moon_prep *m, float d, float ra, float rb)
 {
-    float a;
-    float b;
+    m->d = d;
+    m->ra = ra;
+    m->rb = rb;
+    m->a = (ra*ra - rb*rb + d*d)/(2.0 * d);
+    m->b = sqrt(sdf_max(ra*ra - m->a*m->a, 0.0));
+}
+
+float sdf_moon_prepared(struct vec2 p, const struct sdf_moon_prep *m)
+{
+    float a, b, d;
     float out;
 
     p.y = fabs(p.y);
 
-    a = (ra*ra - rb*rb + d*d)/(2.0 * d);
-    b = sqrt(sdf_max(ra*ra - a*a, 0.0));
+    a = m->a;
+    b = m->b;
+    d = m->d;
 
     out = 0;
 
     if (d*(p.x*b - p.y*a) > d*d*sdf_max(b-p.y, 0.0)) {
         out = svec2_length(svec2_subtract(p, svec2(a, b)));
     } else {
-        out = sdf_max(svec2_length(p) - ra,
-                      -(svec2_length(svec2_subtract(p, svec2(d, 0))) - rb));
+        out = sdf_max(svec2_length(p) - m->ra,
+                      -(svec2_length(svec2_subtract(p, svec2(d, 0))) - m->rb));
     }
 
     return out;
 }
 
+float sdf_moon(struct vec2 p, float d, float ra, float rb)
+{
+    struct sdf_moon_prep m;
+    sdf_moon_prepare(&m, d, ra, rb);
+    return sdf_moon_prepared(p, &m);
+}
+
 float sdf_polygon(struct vec2 *v, int N, struct vec2 p)
 {
     float d;
@@ -584,3 +681,524 @@ float sdf_subtract(float d1, float d2)
 {
     return sdf_max(-d1, d2);
 }
+
+/* Bounds
+ *
+ * These are for culling passes that only need to know how
+ * far away the edge is at least. Each one is built from a
+ * superset of the shape for the outside (a negative result
+ * from it is meaningless, so it's only used when positive)
+ * and a subset for the inside, both made of half-planes so
+ * they're Lipschitz-1 and mostly free of square roots.
+ * Between the two, 0 is returned, which is always safe.
+ */
+
+static float bound_combine(float outer, float inner)
+{
+    if (outer > 0) return outer;
+    if (inner < 0) return inner;
+    return 0;
+}
+
+/* half-plane distances to an axis-aligned box */
+static float slab(struct vec2 p, struct vec2 lo, struct vec2 hi)
+{
+    return sdf_max(sdf_max(lo.x - p.x, p.x - hi.x),
+                   sdf_max(lo.y - p.y, p.y - hi.y));
+}
+
+float sdf_ellipse_bound(struct vec2 p, struct vec2 ab)
+{
+    float k;
+
+    /* |p/ab| changes no faster than 1/min(a,b), so scaling by
+     * min(a,b) gives a Lipschitz-1 function that is zero on
+     * the ellipse.
+     */
+    k = svec2_length(svec2_divide(p, ab));
+    return (k - 1.0) * sdf_min(ab.x, ab.y);
+}
+
+float sdf_egg_bound(struct vec2 p, float ra, float rb)
+{
+    float outer, inner;
+
+    outer = slab(p,
+                 svec2(-ra, -ra),
+                 svec2(ra, 1.7320508*(ra - rb) + rb));
+
+    /* square inscribed in the bottom disk */
+    inner = sdf_max(fabs(p.x), fabs(p.y)) - ra*0.7071068;
+
+    return bound_combine(outer, inner);
+}
+
+float sdf_moon_bound(struct vec2 p, float d, float ra, float rb)
+{
+    float outer, inner;
+    float cx, s;
+
+    p.y = fabs(p.y);
+    outer = sdf_max(fabs(p.x), p.y) - ra;
+
+    /* square in the thick part, left of the bite and inside
+     * the outer disk
+     */
+    cx = 0.5*(d - rb - ra);
+    s = sdf_min(0.5*(ra + d - rb), 0.5*(ra - fabs(cx)));
+    if (s <= 0) return sdf_max(outer, 0);
+    inner = sdf_max(fabs(p.x - cx), p.y) - s;
+
+    return bound_combine(outer, inner);
+}
+
+float sdf_star5_bound(struct vec2 p, float r, float rf)
+{
+    float outer, inner;
+    float ri, ro;
+
+    /* hull of both vertex sets: tips at radius r, one pointing
+     * up, and the inner vertices at r*rf, one pointing down.
+     * Fat stars push the inner vertices past the tips.
+     */
+    ro = sdf_max(r, r*rf);
+    outer = slab(p,
+                 svec2(-0.9510565*ro, -sdf_max(0.8090170*r, r*rf)),
+                 svec2(0.9510565*ro, sdf_max(r, 0.8090170*r*rf)));
+
+    /* lower bound on the inscribed circle of the star,
+     * then the square inside that
+     */
+    ri = r*rf*0.5877853/(1.0 + rf);
+    inner = sdf_max(fabs(p.x), fabs(p.y)) - ri*0.7071068;
+
+    return bound_combine(outer, inner);
+}
+
+float sdf_hexagram_bound(struct vec2 p, float r)
+{
+    float outer, inner;
+
+    p = svec2_abs(p);
+
+    /* hexagon through the six tips */
+    outer = sdf_max(p.x, 0.5*p.x + 0.8660254*p.y) - 1.7320508*r;
+
+    /* the hexagon in the middle, apothem r */
+    inner = sdf_max(p.y, 0.8660254*p.x + 0.5*p.y) - r;
+
+    return bound_combine(outer, inner);
+}
+
+float sdf_vesica_bound(struct vec2 p, float r, float d)
+{
+    float outer, inner;
+    float b, w;
+
+    p = svec2_abs(p);
+    b = sqrt(sdf_max(r*r - d*d, 0.0));
+    w = r - d;
+
+    /* bounding box, plus the tangents at the tips */
+    outer = sdf_max(sdf_max(p.x - w, p.y - b),
+                    (p.x*d + p.y*b - b*b) / r);
+
+    /* box inscribed in the rhombus between the tips */
+    inner = sdf_max(p.x - 0.5*w, p.y - 0.5*b);
+
+    return bound_combine(outer, inner);
+}
+
+float sdf_polygon_bound(struct vec2 *v, int N, struct vec2 p)
+{
+    struct vec2 lo, hi;
+    int i;
+
+    if (N <= 0) return 0;
+
+    lo = hi = v[0];
+
+    for (i = 1; i < N; i++) {
+        if (v[i].x < lo.x) lo.x = v[i].x;
+        if (v[i].y < lo.y) lo.y = v[i].y;
+        if (v[i].x > hi.x) hi.x = v[i].x;
+        if (v[i].y > hi.y) hi.y = v[i].y;
+    }
+
+    return sdf_max(slab(p, lo, hi), 0);
+}
+
+/* Paths
+ *
+ * A path is a closed loop made of line, quadratic bezier,
+ * and circular arc segments. Distance is the minimum of the
+ * exact per-segment distances, sign comes from counting
+ * crossings of a ray heading in +x (even-odd rule, same as
+ * sdf_polygon). Each segment is split up into pieces that
+ * are monotonic in y so the crossing test is robust at
+ * the joints.
+ */
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void add_piece(struct sdf_path_seg *s,
+                      float t0, float t1,
+                      float y0, float y1)
+{
+    int n;
+    n = s->npieces;
+    if (n >= SDF_PATH_MAXPIECES) return;
+    s->piece[n].t0 = t0;
+    s->piece[n].t1 = t1;
+    s->piece[n].y0 = y0;
+    s->piece[n].y1 = y1;
+    s->npieces++;
+}
+
+void sdf_path_line(struct sdf_path_seg *s, struct vec2 a, struct vec2 b)
+{
+    float l;
+
+    s->type = SDF_PATH_LINE;
+    s->p[0] = a;
+    s->p[1] = b;
+    s->p[2] = b;
+    s->r = s->a0 = s->a1 = 0;
+
+    /* u: edge vector, k[0]: 1/dot(e,e) */
+    s->u = svec2_subtract(b, a);
+    s->v = svec2_zero();
+    l = svec2_dot(s->u, s->u);
+    s->k[0] = l != 0 ? 1.0 / l : 0;
+    s->k[1] = s->k[2] = 0;
+
+    s->npieces = 0;
+    add_piece(s, 0, 1, a.y, b.y);
+}
+
+static float quad_y(const struct sdf_path_seg *s, float t)
+{
+    return s->p[0].y + 2.0*t*s->u.y + t*t*s->v.y;
+}
+
+void sdf_path_quad(struct sdf_path_seg *s,
+                   struct vec2 a, struct vec2 c, struct vec2 b)
+{
+    float bb;
+    float tm;
+
+    /* u = control - start, v = start - 2*control + end */
+    s->u = svec2_subtract(c, a);
+    s->v = svec2_add(svec2_subtract(a, svec2_multiply_f(c, 2.0)), b);
+    bb = svec2_dot(s->v, s->v);
+
+    if (bb < 1e-12) {
+        /* control point on the chord midpoint: it's a line */
+        sdf_path_line(s, a, b);
+        return;
+    }
+
+    s->type = SDF_PATH_QUAD;
+    s->p[0] = a;
+    s->p[1] = c;
+    s->p[2] = b;
+    s->r = s->a0 = s->a1 = 0;
+
+    /* the parts of iq's sdBezier that don't depend on the point */
+    s->k[0] = 1.0 / bb;
+    s->k[1] = s->k[0] * svec2_dot(s->u, s->v);
+    s->k[2] = s->k[0] * 2.0 * svec2_dot(s->u, s->u) / 3.0;
+
+    s->npieces = 0;
+
+    /* split at the y extremum, if there is one inside */
+    tm = -1;
+    if (s->v.y != 0) tm = -s->u.y / s->v.y;
+
+    if (tm > 0 && tm < 1) {
+        add_piece(s, 0, tm, a.y, quad_y(s, tm));
+        add_piece(s, tm, 1, quad_y(s, tm), b.y);
+    } else {
+        add_piece(s, 0, 1, a.y, b.y);
+    }
+}
+
+void sdf_path_arc(struct sdf_path_seg *s,
+                  struct vec2 c, float r, float a0, float a1)
+{
+    float m, h;
+    float t, e, y;
+    int dir;
+
+    s->type = SDF_PATH_ARC;
+    s->p[0] = svec2(c.x + r*cos(a0), c.y + r*sin(a0));
+    s->p[1] = c;
+    s->p[2] = svec2(c.x + r*cos(a1), c.y + r*sin(a1));
+    s->r = r;
+    s->a0 = a0;
+    s->a1 = a1;
+
+    /* u: rotation taking the middle of the arc to +y
+     * v: sin/cos of the half aperture (iq's sdArc "sc")
+     */
+    m = 0.5*(a0 + a1);
+    h = 0.5*fabs(a1 - a0);
+    if (h > M_PI) h = M_PI;
+    s->u = svec2(sin(m), cos(m));
+    s->v = svec2(sin(h), cos(h));
+    s->k[0] = s->k[1] = s->k[2] = 0;
+
+    /* split at the top and bottom of the circle, walking
+     * from a0 to a1 so the pieces stay in path order
+     */
+    s->npieces = 0;
+    dir = a1 >= a0 ? 1 : -1;
+    t = a0;
+    y = s->p[0].y;
+
+    while (s->npieces < SDF_PATH_MAXPIECES - 1) {
+        if (dir > 0) {
+            e = ceil((t - 0.5*M_PI) / M_PI) * M_PI + 0.5*M_PI;
+            if (e <= t) e += M_PI;
+            if (e >= a1) break;
+        } else {
+            e = floor((t - 0.5*M_PI) / M_PI) * M_PI + 0.5*M_PI;
+            if (e >= t) e -= M_PI;
+            if (e <= a1) break;
+        }
+        add_piece(s, t, e, y, c.y + r*sin(e));
+        t = e;
+        y = c.y + r*sin(e);
+    }
+
+    add_piece(s, t, a1, y, s->p[2].y);
+}
+
+static float path_line_dist2(const struct sdf_path_seg *s, struct vec2 p)
+{
+    struct vec2 w;
+    float t;
+
+    w = svec2_subtract(p, s->p[0]);
+    t = clampf(svec2_dot(w, s->u) * s->k[0], 0.0, 1.0);
+    return dot2(svec2_subtract(w, svec2_multiply_f(s->u, t)));
+}
+
+static float path_quad_dist2(const struct sdf_path_seg *s, struct vec2 pos)
+{
+    struct vec2 a, b, c, d;
+    float kk, kx, ky, kz;
+    float p, p3, q, h;
+    float res;
+
+    a = s->u;
+    b = s->v;
+    c = svec2_multiply_f(a, 2.0);
+    d = svec2_subtract(s->p[0], pos);
+
+    kk = s->k[0];
+    kx = s->k[1];
+    ky = s->k[2] + kk*svec2_dot(d, b)/3.0;
+    kz = kk*svec2_dot(d, a);
+
+    p = ky - kx*kx;
+    p3 = p*p*p;
+    q = kx*(2.0*kx*kx - 3.0*ky) + kz;
+    h = q*q + 4.0*p3;
+
+    if (h >= 0.0) {
+        float x0, x1;
+        float t;
+
+        h = sqrt(h);
+        x0 = 0.5*(h - q);
+        x1 = 0.5*(-h - q);
+        t = sdf_sign(x0)*pow(fabs(x0), 1.0/3.0) +
+            sdf_sign(x1)*pow(fabs(x1), 1.0/3.0) - kx;
+        t = clampf(t, 0.0, 1.0);
+
+        /* dot2(d + (c + b*t)*t) */
+        res = dot2(svec2_add(d,
+                   svec2_multiply_f(svec2_add(c,
+                                    svec2_multiply_f(b, t)), t)));
+    } else {
+        float z, v, m, n;
+        float t0, t1;
+
+        z = sqrt(-p);
+        v = acos(q/(p*z*2.0))/3.0;
+        m = cos(v);
+        n = sin(v)*1.732050808;
+        t0 = clampf((m + m)*z - kx, 0.0, 1.0);
+        t1 = clampf((-n - m)*z - kx, 0.0, 1.0);
+        res = sdf_min(
+            dot2(svec2_add(d,
+                 svec2_multiply_f(svec2_add(c,
+                                  svec2_multiply_f(b, t0)), t0))),
+            dot2(svec2_add(d,
+                 svec2_multiply_f(svec2_add(c,
+                                  svec2_multiply_f(b, t1)), t1))));
+    }
+
+    return res;
+}
+
+static float path_arc_dist2(const struct sdf_path_seg *s, struct vec2 p)
+{
+    struct vec2 q;
+    float l;
+
+    p = svec2_subtract(p, s->p[1]);
+    q.x = fabs(s->u.x*p.x - s->u.y*p.y);
+    q.y = s->u.y*p.x + s->u.x*p.y;
+
+    if (s->v.y*q.x > s->v.x*q.y) {
+        return dot2(svec2_subtract(q, svec2_multiply_f(s->v, s->r)));
+    }
+
+    l = svec2_length(q) - s->r;
+    return l*l;
+}
+
+/* x position where a y-monotonic piece crosses the scanline y */
+static float path_crossing(const struct sdf_path_seg *s, int i, float y)
+{
+    float t;
+    float t0, t1;
+
+    t0 = s->piece[i].t0;
+    t1 = s->piece[i].t1;
+
+    if (s->type == SDF_PATH_LINE) {
+        t = (y - s->p[0].y) / s->u.y;
+        return s->p[0].x + t*s->u.x;
+    } else if (s->type == SDF_PATH_QUAD) {
+        float a, b, c;
+        float h;
+
+        /* solve v.y*t^2 + 2*u.y*t + (p0.y - y) = 0 on [t0, t1] */
+        a = s->v.y;
+        b = s->u.y;
+        c = s->p[0].y - y;
+
+        if (fabs(a) < 1e-9) {
+            t = -c / (2.0*b);
+        } else {
+            h = sqrt(sdf_max(b*b - a*c, 0.0));
+            t = (-b + h) / a;
+            if (t < t0 - 1e-4 || t > t1 + 1e-4) t = (-b - h) / a;
+        }
+        t = clampf(t, t0, t1);
+        return s->p[0].x + 2.0*t*s->u.x + t*t*s->v.x;
+    } else {
+        float dy, dx;
+
+        dy = y - s->p[1].y;
+        dx = sqrt(sdf_max(s->r*s->r - dy*dy, 0.0));
+        /* which half of the circle is this piece on? */
+        if (cos(0.5*(t0 + t1)) < 0) dx = -dx;
+        return s->p[1].x + dx;
+    }
+}
+
+
+float sdf_path(const struct sdf_path_seg *s, int n, struct vec2 p)
+{
+    float d;
+    float sgn;
+    int i, k;
+    const struct sdf_path_seg *prev;
+
+    d = -1;
+    sgn = 1.0;
+
+    if (n <= 0) return 0;
+
+    prev = &s[n - 1];
+
+    for (i = 0; i < n; i++) {
+        const struct sdf_path_seg *seg;
+        float tmp;
+        float ystart;
+
+        seg = &s[i];
+
+        switch (seg->type) {
+            case SDF_PATH_QUAD:
+                tmp = path_quad_dist2(seg, p);
+                break;
+            case SDF_PATH_ARC:
+                tmp = path_arc_dist2(seg, p);
+                break;
+            default:
+                tmp = path_line_dist2(seg, p);
+                break;
+        }
+
+        if (d < 0 || tmp < d) d = tmp;
+
+        /* computed arc endpoints won't match the neighbors
+         * bit for bit, so snap joints to the previous segment
+         * to keep the crossing count consistent.
+         */
+        ystart = seg->piece[0].y0;
+        if (fabs(prev->p[2].x - seg->p[0].x) < 1e-5 &&
+            fabs(prev->p[2].y - seg->p[0].y) < 1e-5) {
+            ystart = prev->piece[prev->npieces - 1].y1;
+        }
+
+        for (k = 0; k < seg->npieces; k++) {
+            int c0, c1;
+            c0 = (k == 0 ? ystart : seg->piece[k].y0) <= p.y;
+            c1 = seg->piece[k].y1 <= p.y;
+            if (c0 != c1 && path_crossing(seg, k, p.y) > p.x) {
+                sgn = -sgn;
+            }
+        }
+
+        prev = seg;
+    }
+
+    if (d < 0) return 0;
+
+    return sgn * sqrt(d);
+}
+
+float sdf_field(const struct sdf_field *f, struct vec2 p)
+{
+    struct vec2 q;
+    float fx, fy, tx, ty;
+    float out, d;
+    const float *s;
+    int x, y;
+
+    if (f->w < 2 || f->h < 2) return 0;
+
+    q = p;
+    if (q.x < f->lo.x) q.x = f->lo.x;
+    if (q.x > f->hi.x) q.x = f->hi.x;
+    if (q.y < f->lo.y) q.y = f->lo.y;
+    if (q.y > f->hi.y) q.y = f->hi.y;
+
+    out = 0;
+    if (q.x != p.x || q.y != p.y) {
+        out = sqrt((p.x - q.x)*(p.x - q.x) + (p.y - q.y)*(p.y - q.y));
+    }
+
+    fx = (q.x - f->lo.x) / (f->hi.x - f->lo.x) * (f->w - 1);
+    fy = (q.y - f->lo.y) / (f->hi.y - f->lo.y) * (f->h - 1);
+    x = fx;
+    y = fy;
+    if (x > f->w - 2) x = f->w - 2;
+    if (y > f->h - 2) y = f->h - 2;
+    tx = fx - x;
+    ty = fy - y;
+
+    s = f->d + y * f->w + x;
+    d = (s[0] + (s[1] - s[0]) * tx) * (1 - ty) +
+        (s[f->w] + (s[f->w + 1] - s[f->w]) * tx) * ty;
+
+    return d + out;
+}
@@ -27,4 +27,129 @@ float sdf_onion(float d, float r);
 float sdf_union(float d1, float d2);
 float sdf_union_smooth(float d1, float d2, float k);
 float sdf_subtract(float d1, float d2);
+
+/* prepared shapes: derived constants are computed once by
+ * the _prepare call, and _prepared evaluates with them.
+ * Reciprocals and folded constants round differently, so
+ * results match the unprepared kernels to within float
+ * rounding, not bit for bit.
+ * (polygons get the same treatment by building a path of lines)
+ */
+
+struct sdf_rhombus_prep {
+    struct vec2 b;
+    float inv;
+    float bxby;
+};
+
+struct sdf_star5_prep {
+    float r;
+    struct vec2 ba;
+    float inv;
+};
+
+struct sdf_vesica_prep {
+    float r, d;
+    float b;
+};
+
+struct sdf_egg_prep {
+    float r, rb;
+    float kr;
+};
+
+struct sdf_ellipse_prep {
+    struct vec2 ab;
+    float il;
+};
+
+struct sdf_moon_prep {
+    float d, ra, rb;
+    float a, b;
+};
+
+void sdf_rhombus_prepare(struct sdf_rhombus_prep *rh, struct vec2 b);
+float sdf_rhombus_prepared(struct vec2 p, const struct sdf_rhombus_prep *rh);
+void sdf_star5_prepare(struct sdf_star5_prep *s, float r, float rf);
+float sdf_star5_prepared(struct vec2 p, const struct sdf_star5_prep *s);
+void sdf_vesica_prepare(struct sdf_vesica_prep *v, float r, float d);
+float sdf_vesica_prepared(struct vec2 p, const struct sdf_vesica_prep *v);
+void sdf_egg_prepare(struct sdf_egg_prep *e, float ra, float rb);
+float sdf_egg_prepared(struct vec2 p, const struct sdf_egg_prep *e);
+void sdf_ellipse_prepare(struct sdf_ellipse_prep *e, struct vec2 ab);
+float sdf_ellipse_prepared(struct vec2 p, const struct sdf_ellipse_prep *e);
+void sdf_moon_prepare(struct sdf_moon_prep *m, float d, float ra, float rb);
+float sdf_moon_prepared(struct vec2 p, const struct sdf_moon_prep *m);
+
+/* cheap conservative bounds: never larger in magnitude than
+ * the true distance, and the same sign whenever non-zero.
+ */
+float sdf_ellipse_bound(struct vec2 p, struct vec2 ab);
+float sdf_egg_bound(struct vec2 p, float ra, float rb);
+float sdf_moon_bound(struct vec2 p, float d, float ra, float rb);
+float sdf_star5_bound(struct vec2 p, float r, float rf);
+float sdf_hexagram_bound(struct vec2 p, float r);
+float sdf_vesica_bound(struct vec2 p, float r, float d);
+float sdf_polygon_bound(struct vec2 *v, int N, struct vec2 p);
+
+enum {
+    SDF_PATH_LINE,
+    SDF_PATH_QUAD,
+    SDF_PATH_ARC
+};
+
+#define SDF_PATH_MAXPIECES 4
+
+/* one segment of a closed path. the p/r/a fields are the
+ * user-facing description, everything else is derived by
+ * the sdf_path_line/quad/arc constructors so that the
+ * per-pixel evaluation doesn't need to redo it.
+ */
+struct sdf_path_seg {
+    int type;
+    /* p[0] is always the start and p[2] the end.
+     * p[1] is the control point for quads, and the center for arcs
+     */
+    struct vec2 p[3];
+    /* arc: radius, start angle, end angle (radians) */
+    float r, a0, a1;
+
+    /* prepared data */
+    struct vec2 u, v;
+    float k[3];
+    int npieces;
+    struct {
+        float t0, t1;
+        float y0, y1;
+    } piece[SDF_PATH_MAXPIECES];
+};
+
+struct sdf_path {
+    struct sdf_path_seg *segs;
+    int nsegs;
+};
+
+void sdf_path_line(struct sdf_path_seg *s, struct vec2 a, struct vec2 b);
+void sdf_path_quad(struct sdf_path_seg *s,
+                   struct vec2 a, struct vec2 c, struct vec2 b);
+void sdf_path_arc(struct sdf_path_seg *s,
+                  struct vec2 c, float r, float a0, float a1);
+float sdf_path(const struct sdf_path_seg *s, int n, struct vec2 p);
+
+/* Distances sampled on a w x h grid whose corner samples sit
+ * on lo and hi, row by row from lo.y. See sdfbake.h for
+ * filling one.
+ */
+struct sdf_field {
+    float *d;
+    int w, h;
+    struct vec2 lo, hi;
+    /* bound on how fast sdf_field changes, set by the bake */
+    float lipschitz;
+};
+
+/* bilinear in the grid. Outside it, the nearest edge value
+ * plus the distance to the grid.
+ */
+float sdf_field(const struct sdf_field *f, struct vec2 p);
 #endif
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfvm.h"
+#include "sdfshape.h"
+#include "sdfbake.h"
+
+int sdfbake_init(struct sdf_field *f,
+                 int w, int h,
+                 struct vec2 lo, struct vec2 hi)
+{
+    memset(f, 0, sizeof(struct sdf_field));
+
+    if (w < 2 || h < 2 || hi.x <= lo.x || hi.y <= lo.y) {
+        return SDFBAKE_NOT_OK;
+    }
+
+    f->d = calloc((size_t)w * h, sizeof(float));
+    if (f->d == NULL) return SDFBAKE_NOT_OK;
+
+    f->w = w;
+    f->h = h;
+    f->lo = lo;
+    f->hi = hi;
+
+    return SDFBAKE_OK;
+}
+
+void sdfbake_clean(struct sdf_field *f)
+{
+    free(f->d);
+    memset(f, 0, sizeof(struct sdf_field));
+}
+
+static struct vec2 grid_point(const struct sdf_field *f, float x, float y)
+{
+    return svec2(f->lo.x + (f->hi.x - f->lo.x) * x / (f->w - 1),
+                 f->lo.y + (f->hi.y - f->lo.y) * y / (f->h - 1));
+}
+
+/* Inside a cell, each partial derivative of the bilinear
+ * blend is between those along the cell's two edges, so the
+ * largest edge slopes bound the gradient. Outside, the edge
+ * value plus the distance to the grid adds one in quadrature,
+ * as projecting onto a box splits a step into two orthogonal
+ * parts no longer than it.
+ */
+static void lipschitz(struct sdf_field *f)
+{
+    float cw, ch;
+    float gx, gy;
+    int x, y;
+
+    cw = (f->hi.x - f->lo.x) / (f->w - 1);
+    ch = (f->hi.y - f->lo.y) / (f->h - 1);
+    gx = gy = 0;
+
+    for (y = 0; y < f->h; y++) {
+        const float *s;
+        s = f->d + y * f->w;
+        for (x = 0; x < f->w; x++) {
+            float g;
+            if (x + 1 < f->w) {
+                g = fabs(s[x + 1] - s[x]) / cw;
+                if (g > gx) gx = g;
+            }
+            if (y + 1 < f->h) {
+                g = fabs(s[x + f->w] - s[x]) / ch;
+                if (g > gy) gy = g;
+            }
+        }
+    }
+
+    f->lipschitz = sqrt(gx*gx + gy*gy + 1);
+}
+
+void sdfbake_dist(struct sdf_field *f, sdfbake_fn dist, void *ud)
+{
+    int x, y;
+
+    for (y = 0; y < f->h; y++) {
+        for (x = 0; x < f->w; x++) {
+            f->d[y * f->w + x] = dist(grid_point(f, x, y), ud);
+        }
+    }
+
+    lipschitz(f);
+}
+
+typedef struct {
+    int id;
+    const void *params;
+} shape_ud;
+
+static float shape_dist(struct vec2 p, void *ud)
+{
+    shape_ud *s;
+    s = ud;
+    return sdfshape_dist(s->id, p, s->params);
+}
+
+int sdfbake_shape(struct sdf_field *f, int id, const void *params)
+{
+    shape_ud s;
+
+    if (sdfshape_get(id) == NULL) return SDFBAKE_NOT_OK;
+
+    s.id = id;
+    s.params = params;
+    sdfbake_dist(f, shape_dist, &s);
+
+    return SDFBAKE_OK;
+}
+
+typedef struct {
+    sdfvm *vm;
+    const uint8_t *program;
+    size_t sz;
+    int rc;
+} program_ud;
+
+static float program_dist(struct vec2 p, void *ud)
+{
+    program_ud *pr;
+    float d;
+
+    pr = ud;
+    if (pr->rc) return 0;
+
+    sdfvm_point_set(pr->vm, p);
+    pr->rc = sdfvm_execute(pr->vm, pr->program, pr->sz);
+    if (!pr->rc) pr->rc = sdfvm_pop_scalar(pr->vm, &d);
+
+    return pr->rc ? 0 : d;
+}
+
+int sdfbake_program(struct sdf_field *f,
+                    sdfvm *vm,
+                    const uint8_t *program,
+                    size_t sz)
+{
+    program_ud pr;
+
+    pr.vm = vm;
+    pr.program = program;
+    pr.sz = sz;
+    pr.rc = 0;
+    sdfbake_dist(f, program_dist, &pr);
+
+    return pr.rc ? SDFBAKE_NOT_OK : SDFBAKE_OK;
+}
+
+void sdfbake_check_dist(const struct sdf_field *f,
+                        sdfbake_fn dist,
+                        void *ud,
+                        int sub,
+                        float band,
+                        sdfbake_error *err)
+{
+    double sum, esum;
+    int x, y, i, j;
+
+    memset(err, 0, sizeof(sdfbake_error));
+    if (sub < 1) sub = 1;
+
+    sum = esum = 0;
+
+    for (y = 0; y < f->h - 1; y++) {
+        for (x = 0; x < f->w - 1; x++) {
+            for (j = 0; j < sub; j++) {
+                for (i = 0; i < sub; i++) {
+                    struct vec2 p;
+                    float exact, e;
+
+                    p = grid_point(f,
+                                   x + (i + 0.5f) / sub,
+                                   y + (j + 0.5f) / sub);
+                    exact = dist(p, ud);
+                    e = fabs(sdf_field(f, p) - exact);
+
+                    sum += e * e;
+                    err->npoints++;
+                    if (e > err->max) {
+                        err->max = e;
+                        err->worst = p;
+                    }
+
+                    if (fabs(exact) < band) {
+                        esum += e * e;
+                        err->nedge++;
+                        if (e > err->edge_max) err->edge_max = e;
+                    }
+                }
+            }
+        }
+    }
+
+    if (err->npoints > 0) err->rms = sqrt(sum / err->npoints);
+    if (err->nedge > 0) err->edge_rms = sqrt(esum / err->nedge);
+}
+
+int sdfbake_check_shape(const struct sdf_field *f,
+                        int id,
+                        const void *params,
+                        int sub,
+                        float band,
+                        sdfbake_error *err)
+{
+    shape_ud s;
+
+    if (sdfshape_get(id) == NULL) return SDFBAKE_NOT_OK;
+
+    s.id = id;
+    s.params = params;
+    sdfbake_check_dist(f, shape_dist, &s, sub, band, err);
+
+    return SDFBAKE_OK;
+}
+
+int sdfbake_check_program(const struct sdf_field *f,
+                          sdfvm *vm,
+                          const uint8_t *program,
+                          size_t sz,
+                          int sub,
+                          float band,
+                          sdfbake_error *err)
+{
+    program_ud pr;
+
+    pr.vm = vm;
+    pr.program = program;
+    pr.sz = sz;
+    pr.rc = 0;
+    sdfbake_check_dist(f, program_dist, &pr, sub, band, err);
+
+    return pr.rc ? SDFBAKE_NOT_OK : SDFBAKE_OK;
+}
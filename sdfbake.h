@@ -0,0 +1,77 @@
+#ifndef SDF2D_SDFBAKE_H
+#define SDF2D_SDFBAKE_H
+
+enum {
+    SDFBAKE_OK,
+    SDFBAKE_NOT_OK
+};
+
+/* a distance to bake or check against, negative inside */
+typedef float (*sdfbake_fn)(struct vec2 p, void *ud);
+
+/* How far a field is from the exact distance, in distance
+ * units. The edge figures only count points within the band
+ * given to the check, which is where the error moves edges.
+ */
+typedef struct {
+    float max;
+    float rms;
+    float edge_max;
+    float edge_rms;
+    long npoints;
+    long nedge;
+    /* where max is */
+    struct vec2 worst;
+} sdfbake_error;
+
+/* Allocate a w x h grid from lo to hi, at least 2 x 2. Bake
+ * over the shape's bounds plus a margin as wide as any feather,
+ * or the edge of the grid cuts into it.
+ */
+int sdfbake_init(struct sdf_field *f,
+                 int w, int h,
+                 struct vec2 lo, struct vec2 hi);
+void sdfbake_clean(struct sdf_field *f);
+
+/* Sample dist at every grid point, and work out the field's
+ * lipschitz from the samples.
+ */
+void sdfbake_dist(struct sdf_field *f, sdfbake_fn dist, void *ud);
+
+/* an sdfshape id and its parameter block */
+int sdfbake_shape(struct sdf_field *f, int id, const void *params);
+
+/* A program that leaves one scalar, with the vm's uniforms,
+ * paths and fields as they are. Returns SDFBAKE_NOT_OK if the
+ * program fails.
+ */
+int sdfbake_program(struct sdf_field *f,
+                    sdfvm *vm,
+                    const uint8_t *program,
+                    size_t sz);
+
+/* Compare the field against dist at sub x sub points inside
+ * every cell, away from the samples, where bilinear is worst.
+ */
+void sdfbake_check_dist(const struct sdf_field *f,
+                        sdfbake_fn dist,
+                        void *ud,
+                        int sub,
+                        float band,
+                        sdfbake_error *err);
+
+int sdfbake_check_shape(const struct sdf_field *f,
+                        int id,
+                        const void *params,
+                        int sub,
+                        float band,
+                        sdfbake_error *err);
+
+int sdfbake_check_program(const struct sdf_field *f,
+                          sdfvm *vm,
+                          const uint8_t *program,
+                          size_t sz,
+                          int sub,
+                          float band,
+                          sdfbake_error *err);
+#endif
@@ -0,0 +1,1195 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "mathc/mathc.h"
+#include "sdfblend.h"
+
+#if defined(__SSE__) && defined(MATHC_USE_SINGLE_FLOATING_POINT)
+#define SDFBLEND_SSE
+#include <xmmintrin.h>
+#ifdef __SSE2__
+#define SDFBLEND_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+static const char *blend_names[] = {
+    "mix",
+    "add",
+    "multiply",
+    "screen"
+};
+
+/* Coverage is the old per-pixel feather() folded into one
+ * expression: with t = clamp(1 - d/feather, 0, 1), inside
+ * pixels saturate to t = 1 and the falloff outside is the
+ * same smoothstep.
+ */
+
+static float coverage(float d, float inv)
+{
+    float t;
+    t = 1.0f - d * inv;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    return t * t * (3.0f - 2.0f * t);
+}
+
+void sdfblend_coverage(float *alpha, const float *d, int n, float feather)
+{
+    int i;
+    float inv;
+
+    i = 0;
+
+    if (feather <= 0) {
+#ifdef SDFBLEND_SSE
+        __m128 zero, one;
+        zero = _mm_setzero_ps();
+        one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 v;
+            v = _mm_loadu_ps(d + i);
+            _mm_storeu_ps(alpha + i, _mm_and_ps(_mm_cmplt_ps(v, zero), one));
+        }
+#endif
+        for (; i < n; i++) alpha[i] = d[i] < 0;
+        return;
+    }
+
+    inv = 1.0f / feather;
+
+#ifdef SDFBLEND_SSE
+    {
+        __m128 zero, one, three, vinv;
+        zero = _mm_setzero_ps();
+        one = _mm_set1_ps(1.0f);
+        three = _mm_set1_ps(3.0f);
+        vinv = _mm_set1_ps(inv);
+        for (; i + 4 <= n; i += 4) {
+            __m128 t;
+            t = _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(d + i), vinv));
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+            t = _mm_mul_ps(_mm_mul_ps(t, t),
+                           _mm_sub_ps(three, _mm_add_ps(t, t)));
+            _mm_storeu_ps(alpha + i, t);
+        }
+    }
+#endif
+
+    for (; i < n; i++) alpha[i] = coverage(d[i], inv);
+}
+
+#ifdef SDFBLEND_SSE
+static __m128 blend4(__m128 v, __m128 c, __m128 a, int mode)
+{
+    __m128 t;
+
+    switch (mode) {
+        case SDFBLEND_ADD:
+            return _mm_add_ps(v, _mm_mul_ps(c, a));
+        case SDFBLEND_MULTIPLY:
+            t = _mm_mul_ps(v, c);
+            break;
+        case SDFBLEND_SCREEN:
+            t = _mm_sub_ps(_mm_add_ps(v, c), _mm_mul_ps(v, c));
+            break;
+        default:
+            t = c;
+            break;
+    }
+
+    return _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(t, v), a));
+}
+#endif
+
+static float blend1(float v, float c, float a, int mode)
+{
+    float t;
+
+    switch (mode) {
+        case SDFBLEND_ADD:
+            return v + c * a;
+        case SDFBLEND_MULTIPLY:
+            t = v * c;
+            break;
+        case SDFBLEND_SCREEN:
+            t = v + c - v * c;
+            break;
+        default:
+            t = c;
+            break;
+    }
+
+    return v + (t - v) * a;
+}
+
+void sdfblend_row(struct vec3 *dst,
+                  const float *alpha,
+                  int n,
+                  struct vec3 clr,
+                  int mode)
+{
+    int i;
+
+    i = 0;
+
+#ifdef SDFBLEND_SSE
+    {
+        /* 4 interleaved RGB pixels are 3 vectors:
+         * rgbr gbrg brgb
+         */
+        __m128 c0, c1, c2;
+        c0 = _mm_setr_ps(clr.x, clr.y, clr.z, clr.x);
+        c1 = _mm_setr_ps(clr.y, clr.z, clr.x, clr.y);
+        c2 = _mm_setr_ps(clr.z, clr.x, clr.y, clr.z);
+        for (; i + 4 <= n; i += 4) {
+            float *px;
+            __m128 a, a0, a1, a2;
+
+            a = _mm_loadu_ps(alpha + i);
+
+            /* skip runs with no coverage */
+            if (_mm_movemask_ps(_mm_cmpgt_ps(a, _mm_setzero_ps())) == 0) {
+                continue;
+            }
+
+            a0 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 0, 0));
+            a1 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1));
+            a2 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 2));
+            px = &dst[i].x;
+            _mm_storeu_ps(px, blend4(_mm_loadu_ps(px), c0, a0, mode));
+            _mm_storeu_ps(px + 4, blend4(_mm_loadu_ps(px + 4), c1, a1, mode));
+            _mm_storeu_ps(px + 8, blend4(_mm_loadu_ps(px + 8), c2, a2, mode));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        float a;
+        a = alpha[i];
+        if (a <= 0) continue;
+        dst[i].x = blend1(dst[i].x, clr.x, a, mode);
+        dst[i].y = blend1(dst[i].y, clr.y, a, mode);
+        dst[i].z = blend1(dst[i].z, clr.z, a, mode);
+    }
+}
+
+void sdfblend_fill(struct vec3 *dst, int n, struct vec3 clr)
+{
+    int i;
+
+    for (i = 0; i < n; i++) dst[i] = clr;
+}
+
+void sdfblend_dist(struct vec3 *dst,
+                   float *d,
+                   int n,
+                   float feather,
+                   struct vec3 clr,
+                   int mode)
+{
+    sdfblend_coverage(d, d, n, feather);
+    sdfblend_row(dst, d, n, clr, mode);
+}
+
+size_t sdfblend_pixsize(int format)
+{
+    switch (format) {
+        case SDFBLEND_RGBA8:
+            return 4;
+        case SDFBLEND_RGB8:
+            return 3;
+        case SDFBLEND_RGB565:
+            return 2;
+        case SDFBLEND_RGBAH:
+            return 8;
+        case SDFBLEND_PLANAR:
+            return 4 * sizeof(float);
+        default:
+            break;
+    }
+
+    return sizeof(struct vec3);
+}
+
+void *sdfblend_pixel(void *buf, int format, long pos)
+{
+    return (unsigned char *)buf + pos * sdfblend_pixsize(format);
+}
+
+/* 8-bit channels, a8 in [1, 255] */
+
+static int blend8(int v, int c, int a8, int mode)
+{
+    int t;
+
+    switch (mode) {
+        case SDFBLEND_ADD:
+            t = v + (c * a8 + 127) / 255;
+            return t > 255 ? 255 : t;
+        case SDFBLEND_MULTIPLY:
+            t = (v * c + 127) / 255;
+            break;
+        case SDFBLEND_SCREEN:
+            t = v + c - (v * c + 127) / 255;
+            break;
+        default:
+            t = c;
+            break;
+    }
+
+    return (v * (255 - a8) + t * a8 + 127) / 255;
+}
+
+static int to8(float x)
+{
+    if (x <= 0) return 0;
+    if (x >= 1) return 255;
+    return (int)(x * 255 + 0.5f);
+}
+
+/* rgba8, or rgb8 with no alpha when size is 3 */
+static void row_rgba8(uint8_t *px,
+                      int size,
+                      const float *alpha,
+                      int n,
+                      struct vec3 clr,
+                      int mode)
+{
+    int i;
+    int c[3];
+
+    c[0] = to8(clr.x);
+    c[1] = to8(clr.y);
+    c[2] = to8(clr.z);
+
+    for (i = 0; i < n; i++, px += size) {
+        int a8;
+
+        a8 = to8(alpha[i]);
+        if (a8 == 0) continue;
+
+        px[0] = blend8(px[0], c[0], a8, mode);
+        px[1] = blend8(px[1], c[1], a8, mode);
+        px[2] = blend8(px[2], c[2], a8, mode);
+        if (size == 4) px[3] = (px[3] * (255 - a8) + 255 * a8 + 127) / 255;
+    }
+}
+
+/* 565 channels widen to 8 bits, blend, then narrow */
+
+static void row_rgb565(uint16_t *px,
+                       const float *alpha,
+                       int n,
+                       struct vec3 clr,
+                       int mode)
+{
+    int i;
+    int c[3];
+
+    c[0] = to8(clr.x);
+    c[1] = to8(clr.y);
+    c[2] = to8(clr.z);
+
+    for (i = 0; i < n; i++) {
+        int a8;
+        int r, g, b;
+
+        a8 = to8(alpha[i]);
+        if (a8 == 0) continue;
+
+        r = (px[i] >> 11) & 0x1f;
+        g = (px[i] >> 5) & 0x3f;
+        b = px[i] & 0x1f;
+
+        r = blend8((r << 3) | (r >> 2), c[0], a8, mode);
+        g = blend8((g << 2) | (g >> 4), c[1], a8, mode);
+        b = blend8((b << 3) | (b >> 2), c[2], a8, mode);
+
+        px[i] = ((r * 31 + 127) / 255) << 11 |
+                ((g * 63 + 127) / 255) << 5 |
+                ((b * 31 + 127) / 255);
+    }
+}
+
+/* IEEE half floats, round to nearest even */
+
+static uint16_t to_half(float f)
+{
+    union { float f; uint32_t u; } v;
+    uint32_t sign, mant, rest;
+    int e;
+    uint16_t h;
+
+    v.f = f;
+    sign = (v.u >> 16) & 0x8000;
+    e = (v.u >> 23) & 0xff;
+    mant = v.u & 0x7fffff;
+
+    if (e == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+
+    e = e - 127 + 15;
+    if (e >= 31) return sign | 0x7c00;
+
+    if (e <= 0) {
+        int shift;
+        if (e < -10) return sign;
+        mant |= 0x800000;
+        shift = 14 - e;
+        h = mant >> shift;
+        rest = mant & ((1UL << shift) - 1);
+        if (rest > (1UL << (shift - 1)) ||
+            (rest == (1UL << (shift - 1)) && (h & 1))) {
+            h++;
+        }
+        return sign | h;
+    }
+
+    h = sign | (e << 10) | (mant >> 13);
+    rest = mant & 0x1fff;
+    /* a carry out of the mantissa bumps the exponent, as it should */
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+
+    return h;
+}
+
+static float from_half(uint16_t h)
+{
+    union { float f; uint32_t u; } v;
+    uint32_t sign;
+    int e;
+    uint32_t mant;
+
+    sign = (uint32_t)(h & 0x8000) << 16;
+    e = (h >> 10) & 0x1f;
+    mant = h & 0x3ff;
+
+    if (e == 0) {
+        float f;
+        f = ldexp(mant, -24);
+        return sign ? -f : f;
+    }
+
+    if (e == 31) {
+        v.u = sign | 0x7f800000 | (mant << 13);
+    } else {
+        v.u = sign | ((uint32_t)(e - 15 + 127) << 23) | (mant << 13);
+    }
+
+    return v.f;
+}
+
+static void row_rgbah(uint16_t *px,
+                      const float *alpha,
+                      int n,
+                      struct vec3 clr,
+                      int mode)
+{
+    int i;
+
+    for (i = 0; i < n; i++, px += 4) {
+        float a;
+
+        a = alpha[i];
+        if (a <= 0) continue;
+
+        px[0] = to_half(blend1(from_half(px[0]), clr.x, a, mode));
+        px[1] = to_half(blend1(from_half(px[1]), clr.y, a, mode));
+        px[2] = to_half(blend1(from_half(px[2]), clr.z, a, mode));
+        px[3] = to_half(blend1(from_half(px[3]), 1, a, SDFBLEND_MIX));
+    }
+}
+
+void sdfblend_row_format(void *dst,
+                         int format,
+                         const float *alpha,
+                         int n,
+                         struct vec3 clr,
+                         int mode)
+{
+    switch (format) {
+        case SDFBLEND_RGBA8:
+            row_rgba8(dst, 4, alpha, n, clr, mode);
+            break;
+        case SDFBLEND_RGB8:
+            row_rgba8(dst, 3, alpha, n, clr, mode);
+            break;
+        case SDFBLEND_RGB565:
+            row_rgb565(dst, alpha, n, clr, mode);
+            break;
+        case SDFBLEND_RGBAH:
+            row_rgbah(dst, alpha, n, clr, mode);
+            break;
+        default:
+            sdfblend_row(dst, alpha, n, clr, mode);
+            break;
+    }
+}
+
+void sdfblend_fill_format(void *dst, int format, int n, struct vec3 clr)
+{
+    int i;
+
+    switch (format) {
+        case SDFBLEND_RGBA8: {
+            uint8_t px[4];
+            uint8_t *out;
+            px[0] = to8(clr.x);
+            px[1] = to8(clr.y);
+            px[2] = to8(clr.z);
+            px[3] = 255;
+            out = dst;
+            for (i = 0; i < n; i++) memcpy(out + 4*i, px, 4);
+            break;
+        }
+        case SDFBLEND_RGB8: {
+            uint8_t *out;
+            out = dst;
+            for (i = 0; i < n; i++, out += 3) {
+                out[0] = to8(clr.x);
+                out[1] = to8(clr.y);
+                out[2] = to8(clr.z);
+            }
+            break;
+        }
+        case SDFBLEND_RGB565: {
+            uint16_t px;
+            uint16_t *out;
+            px = ((to8(clr.x) * 31 + 127) / 255) << 11 |
+                 ((to8(clr.y) * 63 + 127) / 255) << 5 |
+                 ((to8(clr.z) * 31 + 127) / 255);
+            out = dst;
+            for (i = 0; i < n; i++) out[i] = px;
+            break;
+        }
+        case SDFBLEND_RGBAH: {
+            uint16_t px[4];
+            uint16_t *out;
+            px[0] = to_half(clr.x);
+            px[1] = to_half(clr.y);
+            px[2] = to_half(clr.z);
+            px[3] = to_half(1);
+            out = dst;
+            for (i = 0; i < n; i++) memcpy(out + 4*i, px, 8);
+            break;
+        }
+        default:
+            sdfblend_fill(dst, n, clr);
+            break;
+    }
+}
+
+void sdfblend_dist_format(void *dst,
+                          int format,
+                          float *d,
+                          int n,
+                          float feather,
+                          struct vec3 clr,
+                          int mode)
+{
+    sdfblend_coverage(d, d, n, feather);
+    sdfblend_row_format(dst, format, d, n, clr, mode);
+}
+
+/* one interleaved pixel, for the planar conversions */
+
+static void load(const void *src, int format, long i, float *px)
+{
+    switch (format) {
+        case SDFBLEND_RGBA8: {
+            const uint8_t *p;
+            p = (const uint8_t *)src + 4*i;
+            px[0] = p[0] / 255.0f;
+            px[1] = p[1] / 255.0f;
+            px[2] = p[2] / 255.0f;
+            px[3] = p[3] / 255.0f;
+            break;
+        }
+        case SDFBLEND_RGB8: {
+            const uint8_t *p;
+            p = (const uint8_t *)src + 3*i;
+            px[0] = p[0] / 255.0f;
+            px[1] = p[1] / 255.0f;
+            px[2] = p[2] / 255.0f;
+            px[3] = 1;
+            break;
+        }
+        case SDFBLEND_RGB565: {
+            uint16_t p;
+            int r, g, b;
+            p = ((const uint16_t *)src)[i];
+            r = (p >> 11) & 0x1f;
+            g = (p >> 5) & 0x3f;
+            b = p & 0x1f;
+            px[0] = ((r << 3) | (r >> 2)) / 255.0f;
+            px[1] = ((g << 2) | (g >> 4)) / 255.0f;
+            px[2] = ((b << 3) | (b >> 2)) / 255.0f;
+            px[3] = 1;
+            break;
+        }
+        case SDFBLEND_RGBAH: {
+            const uint16_t *p;
+            p = (const uint16_t *)src + 4*i;
+            px[0] = from_half(p[0]);
+            px[1] = from_half(p[1]);
+            px[2] = from_half(p[2]);
+            px[3] = from_half(p[3]);
+            break;
+        }
+        default: {
+            const struct vec3 *p;
+            p = (const struct vec3 *)src + i;
+            px[0] = p->x;
+            px[1] = p->y;
+            px[2] = p->z;
+            px[3] = 1;
+            break;
+        }
+    }
+}
+
+static void store(void *dst, int format, long i, const float *px)
+{
+    switch (format) {
+        case SDFBLEND_RGBA8: {
+            uint8_t *p;
+            p = (uint8_t *)dst + 4*i;
+            p[0] = to8(px[0]);
+            p[1] = to8(px[1]);
+            p[2] = to8(px[2]);
+            p[3] = to8(px[3]);
+            break;
+        }
+        case SDFBLEND_RGB8: {
+            uint8_t *p;
+            p = (uint8_t *)dst + 3*i;
+            p[0] = to8(px[0]);
+            p[1] = to8(px[1]);
+            p[2] = to8(px[2]);
+            break;
+        }
+        case SDFBLEND_RGB565:
+            ((uint16_t *)dst)[i] = ((to8(px[0]) * 31 + 127) / 255) << 11 |
+                                   ((to8(px[1]) * 63 + 127) / 255) << 5 |
+                                   ((to8(px[2]) * 31 + 127) / 255);
+            break;
+        case SDFBLEND_RGBAH: {
+            uint16_t *p;
+            p = (uint16_t *)dst + 4*i;
+            p[0] = to_half(px[0]);
+            p[1] = to_half(px[1]);
+            p[2] = to_half(px[2]);
+            p[3] = to_half(px[3]);
+            break;
+        }
+        default: {
+            struct vec3 *p;
+            p = (struct vec3 *)dst + i;
+            p->x = px[0];
+            p->y = px[1];
+            p->z = px[2];
+            break;
+        }
+    }
+}
+
+int sdfblend_planes_init(sdfblend_planes *pl, int width, int height)
+{
+    int per;
+    size_t plane;
+    float *mem;
+
+    /* floats per aligned block */
+    per = SDFBLEND_ALIGN / sizeof(float);
+
+    pl->width = width;
+    pl->height = height;
+    pl->stride = (width + per - 1) / per * per;
+    plane = (size_t)pl->stride * height;
+
+    if (posix_memalign(&pl->mem, SDFBLEND_ALIGN, 4 * plane * sizeof(float))) {
+        memset(pl, 0, sizeof(sdfblend_planes));
+        return 1;
+    }
+
+    mem = pl->mem;
+    memset(mem, 0, 4 * plane * sizeof(float));
+    pl->r = mem;
+    pl->g = mem + plane;
+    pl->b = mem + 2*plane;
+    pl->a = mem + 3*plane;
+
+    return 0;
+}
+
+void sdfblend_planes_clean(sdfblend_planes *pl)
+{
+    free(pl->mem);
+    memset(pl, 0, sizeof(sdfblend_planes));
+}
+
+void sdfblend_planes_fill(sdfblend_planes *pl, struct vec3 clr)
+{
+    size_t i, n;
+
+    n = (size_t)pl->stride * pl->height;
+
+    for (i = 0; i < n; i++) {
+        pl->r[i] = clr.x;
+        pl->g[i] = clr.y;
+        pl->b[i] = clr.z;
+        pl->a[i] = 1;
+    }
+}
+
+void sdfblend_row_planar(sdfblend_planes *pl,
+                         long pos,
+                         const float *alpha,
+                         int n,
+                         struct vec3 clr,
+                         int mode)
+{
+    float *r, *g, *b, *a;
+    int i;
+
+    r = pl->r + pos;
+    g = pl->g + pos;
+    b = pl->b + pos;
+    a = pl->a + pos;
+
+    i = 0;
+
+#ifdef SDFBLEND_SSE
+    {
+        __m128 cr, cg, cb, one;
+        cr = _mm_set1_ps(clr.x);
+        cg = _mm_set1_ps(clr.y);
+        cb = _mm_set1_ps(clr.z);
+        one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 va;
+
+            va = _mm_loadu_ps(alpha + i);
+            if (_mm_movemask_ps(_mm_cmpgt_ps(va, _mm_setzero_ps())) == 0) {
+                continue;
+            }
+
+            _mm_storeu_ps(r + i, blend4(_mm_loadu_ps(r + i), cr, va, mode));
+            _mm_storeu_ps(g + i, blend4(_mm_loadu_ps(g + i), cg, va, mode));
+            _mm_storeu_ps(b + i, blend4(_mm_loadu_ps(b + i), cb, va, mode));
+            _mm_storeu_ps(a + i,
+                          blend4(_mm_loadu_ps(a + i), one, va, SDFBLEND_MIX));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        float t;
+        t = alpha[i];
+        if (t <= 0) continue;
+        r[i] = blend1(r[i], clr.x, t, mode);
+        g[i] = blend1(g[i], clr.y, t, mode);
+        b[i] = blend1(b[i], clr.z, t, mode);
+        a[i] = blend1(a[i], 1, t, SDFBLEND_MIX);
+    }
+}
+
+void sdfblend_planes_pack(const sdfblend_planes *pl,
+                          long pos,
+                          void *dst,
+                          int format,
+                          int n)
+{
+    int i;
+
+    if (format == SDFBLEND_RGBF) {
+        struct vec3 *out;
+        out = dst;
+        for (i = 0; i < n; i++) {
+            out[i].x = pl->r[pos + i];
+            out[i].y = pl->g[pos + i];
+            out[i].z = pl->b[pos + i];
+        }
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        float px[4];
+        px[0] = pl->r[pos + i];
+        px[1] = pl->g[pos + i];
+        px[2] = pl->b[pos + i];
+        px[3] = pl->a[pos + i];
+        store(dst, format, i, px);
+    }
+}
+
+void sdfblend_planes_unpack(sdfblend_planes *pl,
+                            long pos,
+                            const void *src,
+                            int format,
+                            int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float px[4];
+        load(src, format, i, px);
+        pl->r[pos + i] = px[0];
+        pl->g[pos + i] = px[1];
+        pl->b[pos + i] = px[2];
+        pl->a[pos + i] = px[3];
+    }
+}
+
+/* Z-order walks the power of two square around the tiles,
+ * taking the ones inside, so slots stay dense whatever the
+ * tile counts.
+ */
+
+static void morton_slots(int *slot, int tiles_x, int tiles_y)
+{
+    unsigned long code, side;
+    int next;
+
+    side = 1;
+    while (side < (unsigned long)tiles_x || side < (unsigned long)tiles_y) {
+        side <<= 1;
+    }
+
+    next = 0;
+    for (code = 0; code < side * side; code++) {
+        unsigned long x, y;
+        int bit;
+
+        x = y = 0;
+        for (bit = 0; (side >> bit) > 1; bit++) {
+            x |= ((code >> (2*bit)) & 1) << bit;
+            y |= ((code >> (2*bit + 1)) & 1) << bit;
+        }
+
+        if (x < (unsigned long)tiles_x && y < (unsigned long)tiles_y) {
+            slot[y * tiles_x + x] = next++;
+        }
+    }
+}
+
+int sdfblend_tiles_init(sdfblend_tiles *t,
+                        int width,
+                        int height,
+                        int format,
+                        int order)
+{
+    size_t tilesz;
+    int ntiles, i;
+
+    memset(t, 0, sizeof(sdfblend_tiles));
+
+    if (format == SDFBLEND_PLANAR || format == SDFBLEND_TILED) return 1;
+
+    t->format = format;
+    t->width = width;
+    t->height = height;
+    t->tiles_x = (width + SDFBLEND_TILE - 1) / SDFBLEND_TILE;
+    t->tiles_y = (height + SDFBLEND_TILE - 1) / SDFBLEND_TILE;
+    ntiles = t->tiles_x * t->tiles_y;
+
+    tilesz = sdfblend_pixsize(format) * SDFBLEND_TILE * SDFBLEND_TILE;
+    tilesz = (tilesz + SDFBLEND_LINE - 1) / SDFBLEND_LINE * SDFBLEND_LINE;
+    t->tilesz = tilesz;
+
+    t->slot = malloc(ntiles * sizeof(int));
+    if (t->slot == NULL ||
+        posix_memalign(&t->mem, SDFBLEND_PAGE, ntiles * tilesz)) {
+        free(t->slot);
+        memset(t, 0, sizeof(sdfblend_tiles));
+        return 1;
+    }
+
+    memset(t->mem, 0, ntiles * tilesz);
+
+    if (order == SDFBLEND_TILE_MORTON) {
+        morton_slots(t->slot, t->tiles_x, t->tiles_y);
+    } else {
+        for (i = 0; i < ntiles; i++) t->slot[i] = i;
+    }
+
+    return 0;
+}
+
+void sdfblend_tiles_clean(sdfblend_tiles *t)
+{
+    free(t->mem);
+    free(t->slot);
+    memset(t, 0, sizeof(sdfblend_tiles));
+}
+
+void sdfblend_tiles_fill(sdfblend_tiles *t, struct vec3 clr)
+{
+    int ntiles, i;
+    unsigned char *mem;
+    int per;
+
+    ntiles = t->tiles_x * t->tiles_y;
+    per = SDFBLEND_TILE * SDFBLEND_TILE;
+    mem = t->mem;
+
+    for (i = 0; i < ntiles; i++) {
+        sdfblend_fill_format(mem + i * t->tilesz, t->format, per, clr);
+    }
+}
+
+/* pixel (x, y), and how many follow it in the same tile row */
+
+static unsigned char *tile_at(const sdfblend_tiles *t,
+                              int x, int y,
+                              int *left)
+{
+    int tx, ty;
+    size_t off;
+
+    tx = x / SDFBLEND_TILE;
+    ty = y / SDFBLEND_TILE;
+    x -= tx * SDFBLEND_TILE;
+    y -= ty * SDFBLEND_TILE;
+
+    *left = SDFBLEND_TILE - x;
+    off = t->slot[ty * t->tiles_x + tx] * t->tilesz +
+          (y * SDFBLEND_TILE + x) * sdfblend_pixsize(t->format);
+
+    return (unsigned char *)t->mem + off;
+}
+
+void sdfblend_row_tiled(sdfblend_tiles *t,
+                        long pos,
+                        const float *alpha,
+                        int n,
+                        struct vec3 clr,
+                        int mode)
+{
+    int x, y;
+
+    y = pos / t->width;
+    x = pos - (long)y * t->width;
+
+    while (n > 0) {
+        unsigned char *px;
+        int run;
+
+        px = tile_at(t, x, y, &run);
+        if (run > n) run = n;
+        sdfblend_row_format(px, t->format, alpha, run, clr, mode);
+        alpha += run;
+        x += run;
+        n -= run;
+    }
+}
+
+void sdfblend_tiles_rows(const sdfblend_tiles *t,
+                         int y,
+                         int nrows,
+                         void *dst,
+                         int stride)
+{
+    size_t pixsize;
+    int r;
+
+    pixsize = sdfblend_pixsize(t->format);
+
+    for (r = 0; r < nrows; r++) {
+        unsigned char *out;
+        int x;
+
+        out = (unsigned char *)dst + (size_t)r * stride * pixsize;
+
+        for (x = 0; x < t->width; ) {
+            unsigned char *px;
+            int run;
+
+            px = tile_at(t, x, y + r, &run);
+            if (run > t->width - x) run = t->width - x;
+            memcpy(out, px, run * pixsize);
+            out += run * pixsize;
+            x += run;
+        }
+    }
+}
+
+void sdfblend_fill_rect(void *buf,
+                        int format,
+                        int stride,
+                        int x0, int y0,
+                        int x1, int y1,
+                        struct vec3 clr)
+{
+    int x, y;
+
+    if (x1 <= x0) return;
+
+    for (y = y0; y < y1; y++) {
+        if (format == SDFBLEND_PLANAR) {
+            sdfblend_planes *pl;
+            long pos;
+            pl = buf;
+            pos = (long)y * pl->stride;
+            for (x = x0; x < x1; x++) {
+                pl->r[pos + x] = clr.x;
+                pl->g[pos + x] = clr.y;
+                pl->b[pos + x] = clr.z;
+                pl->a[pos + x] = 1;
+            }
+        } else if (format == SDFBLEND_TILED) {
+            const sdfblend_tiles *t;
+            t = buf;
+            for (x = x0; x < x1; ) {
+                unsigned char *px;
+                int run;
+                px = tile_at(t, x, y, &run);
+                if (run > x1 - x) run = x1 - x;
+                sdfblend_fill_format(px, t->format, run, clr);
+                x += run;
+            }
+        } else {
+            sdfblend_fill_format(sdfblend_pixel(buf, format,
+                                                (long)y * stride + x0),
+                                 format, x1 - x0, clr);
+        }
+    }
+}
+
+static int trunc8(float x)
+{
+    x *= 255;
+    if (x <= 0) return 0;
+    if (x >= 255) return 255;
+    return (int)x;
+}
+
+void sdfblend_rgb8(unsigned char *out, const void *src, int format, int n)
+{
+    int i;
+
+    switch (format) {
+        case SDFBLEND_RGBA8: {
+            const uint8_t *px;
+            px = src;
+            for (i = 0; i < n; i++, px += 4, out += 3) {
+                out[0] = px[0];
+                out[1] = px[1];
+                out[2] = px[2];
+            }
+            break;
+        }
+        case SDFBLEND_RGB8:
+            memcpy(out, src, 3 * (size_t)n);
+            break;
+        case SDFBLEND_RGB565: {
+            const uint16_t *px;
+            px = src;
+            for (i = 0; i < n; i++, out += 3) {
+                int r, g, b;
+                r = (px[i] >> 11) & 0x1f;
+                g = (px[i] >> 5) & 0x3f;
+                b = px[i] & 0x1f;
+                out[0] = (r << 3) | (r >> 2);
+                out[1] = (g << 2) | (g >> 4);
+                out[2] = (b << 3) | (b >> 2);
+            }
+            break;
+        }
+        case SDFBLEND_RGBAH: {
+            const uint16_t *px;
+            px = src;
+            for (i = 0; i < n; i++, px += 4, out += 3) {
+                out[0] = trunc8(from_half(px[0]));
+                out[1] = trunc8(from_half(px[1]));
+                out[2] = trunc8(from_half(px[2]));
+            }
+            break;
+        }
+        default: {
+            const struct vec3 *px;
+            px = src;
+            i = 0;
+#ifdef SDFBLEND_SSE2
+            {
+                /* 16 pixels, 48 floats, to 48 bytes */
+                __m128 scale, zero, top;
+                scale = _mm_set1_ps(255.0f);
+                zero = _mm_setzero_ps();
+                top = _mm_set1_ps(255.0f);
+                for (; i + 16 <= n; i += 16, out += 48) {
+                    const float *f;
+                    __m128i q[12];
+                    int k;
+
+                    f = &px[i].x;
+                    for (k = 0; k < 12; k++) {
+                        __m128 v;
+                        v = _mm_mul_ps(_mm_loadu_ps(f + 4*k), scale);
+                        v = _mm_min_ps(_mm_max_ps(v, zero), top);
+                        q[k] = _mm_cvttps_epi32(v);
+                    }
+                    for (k = 0; k < 3; k++) {
+                        __m128i lo, hi;
+                        lo = _mm_packs_epi32(q[4*k], q[4*k + 1]);
+                        hi = _mm_packs_epi32(q[4*k + 2], q[4*k + 3]);
+                        _mm_storeu_si128((__m128i *)(out + 16*k),
+                                         _mm_packus_epi16(lo, hi));
+                    }
+                }
+            }
+#endif
+            for (; i < n; i++, out += 3) {
+                out[0] = trunc8(px[i].x);
+                out[1] = trunc8(px[i].y);
+                out[2] = trunc8(px[i].z);
+            }
+            break;
+        }
+    }
+}
+
+/* 4x4 ordered dither thresholds, in 1/256ths of a code */
+static const unsigned char bayer[4][4] = {
+    {8, 136, 40, 168},
+    {200, 72, 232, 104},
+    {56, 184, 24, 152},
+    {248, 120, 216, 88}
+};
+
+void sdfblend_quant_init(sdfblend_quant *q, int transfer, int dither)
+{
+    int i;
+    int n;
+
+    n = 1 << SDFBLEND_QUANT_BITS;
+
+    for (i = 0; i < n; i++) {
+        double c;
+
+        c = (double)i / (n - 1);
+        if (transfer == SDFBLEND_SRGB) {
+            if (c <= 0.0031308) c *= 12.92;
+            else c = 1.055 * pow(c, 1 / 2.4) - 0.055;
+        }
+
+        q->lut[i] = (unsigned short)(c * 255 * 256 + 0.5);
+    }
+
+    q->dither = dither;
+}
+
+/* nf floats, 3 to a pixel, to codes. t holds the thresholds
+ * for the row, and the first pixel is at x.
+ */
+static void quant_floats(unsigned char *out,
+                         const float *f,
+                         int nf,
+                         const sdfblend_quant *q,
+                         const unsigned char *t,
+                         int x)
+{
+    int idx[48];
+    int i;
+    int top;
+
+    top = (1 << SDFBLEND_QUANT_BITS) - 1;
+
+    for (i = 0; i < nf; i += 48) {
+        int m;
+        int k;
+        int p;
+
+        m = nf - i < 48 ? nf - i : 48;
+        k = 0;
+
+#ifdef SDFBLEND_SSE2
+        {
+            __m128 zero, one, scale, half;
+            zero = _mm_setzero_ps();
+            one = _mm_set1_ps(1.0f);
+            scale = _mm_set1_ps((float)top);
+            half = _mm_set1_ps(0.5f);
+            for (; k + 4 <= m; k += 4) {
+                __m128 v;
+                v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(f + i + k), zero), one);
+                v = _mm_add_ps(_mm_mul_ps(v, scale), half);
+                _mm_storeu_si128((__m128i *)(idx + k), _mm_cvttps_epi32(v));
+            }
+        }
+#endif
+        for (; k < m; k++) {
+            float v;
+            v = f[i + k];
+            if (v <= 0) idx[k] = 0;
+            else if (v >= 1) idx[k] = top;
+            else idx[k] = (int)(v * top + 0.5f);
+        }
+
+        p = x + i / 3;
+        for (k = 0; k < m; k += 3, p++) {
+            int th;
+            th = t[p & 3];
+            out[i + k] = (q->lut[idx[k]] + th) >> 8;
+            out[i + k + 1] = (q->lut[idx[k + 1]] + th) >> 8;
+            out[i + k + 2] = (q->lut[idx[k + 2]] + th) >> 8;
+        }
+    }
+}
+
+void sdfblend_rgb8_quant(unsigned char *out,
+                         const void *src,
+                         int format,
+                         int n,
+                         const sdfblend_quant *q,
+                         int x,
+                         int y)
+{
+    static const unsigned char half[4] = {128, 128, 128, 128};
+    const unsigned char *t;
+    int i;
+
+    t = q->dither ? bayer[y & 3] : half;
+
+    if (format == SDFBLEND_RGBF) {
+        quant_floats(out, src, 3 * n, q, t, x);
+        return;
+    }
+
+    /* the rest go through floats a chunk at a time */
+    for (i = 0; i < n; i += 16) {
+        float f[48];
+        int m;
+        int k;
+
+        m = n - i < 16 ? n - i : 16;
+        for (k = 0; k < m; k++) {
+            float px[4];
+            load(src, format, i + k, px);
+            f[3*k] = px[0];
+            f[3*k + 1] = px[1];
+            f[3*k + 2] = px[2];
+        }
+
+        quant_floats(out + 3*i, f, 3*m, q, t, x + i);
+    }
+}
+
+int sdfblend_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < SDFBLEND_LAST; i++) {
+        if (!strcmp(blend_names[i], name)) return i;
+    }
+
+    return -1;
+}
+
+const char *sdfblend_name(int mode)
+{
+    if (mode < 0 || mode >= SDFBLEND_LAST) return NULL;
+    return blend_names[mode];
+}
@@ -0,0 +1,237 @@
+#ifndef SDF2D_SDFBLEND_H
+#define SDF2D_SDFBLEND_H
+
+/* row kernels work on at most this many pixels at a time */
+#define SDFBLEND_CHUNK 256
+
+enum {
+    SDFBLEND_MIX,
+    SDFBLEND_ADD,
+    SDFBLEND_MULTIPLY,
+    SDFBLEND_SCREEN,
+    SDFBLEND_LAST
+};
+
+/* canvas pixel formats */
+enum {
+    /* struct vec3, 12 bytes */
+    SDFBLEND_RGBF,
+    /* bytes r, g, b, a */
+    SDFBLEND_RGBA8,
+    /* 16 bits, 5 red in the top bits, 6 green, 5 blue */
+    SDFBLEND_RGB565,
+    /* half floats r, g, b, a */
+    SDFBLEND_RGBAH,
+    /* buf is a sdfblend_planes, positions count in its stride */
+    SDFBLEND_PLANAR,
+    /* bytes r, g, b, as in a PPM body */
+    SDFBLEND_RGB8,
+    /* buf is a sdfblend_tiles, positions count in its width */
+    SDFBLEND_TILED,
+    SDFBLEND_FORMAT_LAST
+};
+
+/* planes and their rows start on this many bytes */
+#define SDFBLEND_ALIGN 32
+
+/* One float plane per channel. Rows are padded to a whole
+ * number of SDFBLEND_ALIGN bytes, so a full-width vector never
+ * reads into the next row or past the end.
+ */
+typedef struct {
+    float *r, *g, *b, *a;
+    int width;
+    int height;
+    /* floats per row */
+    int stride;
+    void *mem;
+} sdfblend_planes;
+
+/* edge of a square storage tile, in pixels. Matches
+ * SDFRENDER_TILE, so each render work tile is one storage tile.
+ */
+#define SDFBLEND_TILE 32
+
+/* tiled canvases start on a page, tiles on a cache line */
+#define SDFBLEND_PAGE 4096
+#define SDFBLEND_LINE 64
+
+/* tile orders */
+enum {
+    SDFBLEND_TILE_ROWS,
+    SDFBLEND_TILE_MORTON
+};
+
+/* Pixels of one interleaved format, stored SDFBLEND_TILE
+ * square tiles at a time. Each tile is contiguous, rows inside
+ * it top to bottom, and takes a whole number of cache lines
+ * (of pages for the 4 byte and wider formats), so two workers
+ * on different tiles never write the same line. Tiles are laid
+ * out row by row or in Z-order, slot maps a tile, counted row
+ * by row, to its place in mem.
+ */
+typedef struct {
+    void *mem;
+    int format;
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    size_t tilesz;
+    int *slot;
+} sdfblend_tiles;
+
+/* signed distances (negative inside) to coverage in [0, 1].
+ * feather is the width of the smoothstep falloff outside
+ * the edge, in distance units. zero or less gives a hard edge.
+ * d and alpha may alias.
+ */
+void sdfblend_coverage(float *alpha, const float *d, int n, float feather);
+
+/* blend a solid colour into a row of pixels, weighted by alpha */
+void sdfblend_row(struct vec3 *dst,
+                  const float *alpha,
+                  int n,
+                  struct vec3 clr,
+                  int mode);
+
+void sdfblend_fill(struct vec3 *dst, int n, struct vec3 clr);
+
+/* coverage, then blend. d is overwritten with the coverage */
+void sdfblend_dist(struct vec3 *dst,
+                   float *d,
+                   int n,
+                   float feather,
+                   struct vec3 clr,
+                   int mode);
+
+/* Pixel formats. The _format kernels take any interleaved one
+ * and do the same as the plain ones on SDFBLEND_RGBF. Blends with an
+ * alpha channel composite coverage into it as well.
+ */
+size_t sdfblend_pixsize(int format);
+void *sdfblend_pixel(void *buf, int format, long pos);
+
+void sdfblend_row_format(void *dst,
+                         int format,
+                         const float *alpha,
+                         int n,
+                         struct vec3 clr,
+                         int mode);
+
+void sdfblend_fill_format(void *dst, int format, int n, struct vec3 clr);
+
+/* fill [x0, x1) x [y0, y1) of a canvas of any format, stride
+ * pixels per row. Planar and tiled canvases use their own.
+ */
+void sdfblend_fill_rect(void *buf,
+                        int format,
+                        int stride,
+                        int x0, int y0,
+                        int x1, int y1,
+                        struct vec3 clr);
+
+void sdfblend_dist_format(void *dst,
+                          int format,
+                          float *d,
+                          int n,
+                          float feather,
+                          struct vec3 clr,
+                          int mode);
+
+/* planar canvases. init returns non-zero when out of memory */
+int sdfblend_planes_init(sdfblend_planes *pl, int width, int height);
+void sdfblend_planes_clean(sdfblend_planes *pl);
+void sdfblend_planes_fill(sdfblend_planes *pl, struct vec3 clr);
+
+void sdfblend_row_planar(sdfblend_planes *pl,
+                         long pos,
+                         const float *alpha,
+                         int n,
+                         struct vec3 clr,
+                         int mode);
+
+/* n pixels from plane position pos to an interleaved buffer
+ * of another format, and back
+ */
+void sdfblend_planes_pack(const sdfblend_planes *pl,
+                          long pos,
+                          void *dst,
+                          int format,
+                          int n);
+void sdfblend_planes_unpack(sdfblend_planes *pl,
+                            long pos,
+                            const void *src,
+                            int format,
+                            int n);
+
+/* tiled canvases. format is any interleaved one, order one of
+ * the tile orders. init returns non-zero when out of memory or
+ * given a format that is not interleaved.
+ */
+int sdfblend_tiles_init(sdfblend_tiles *t,
+                        int width,
+                        int height,
+                        int format,
+                        int order);
+void sdfblend_tiles_clean(sdfblend_tiles *t);
+void sdfblend_tiles_fill(sdfblend_tiles *t, struct vec3 clr);
+
+/* pos is y * width + x. The run may cross tiles. */
+void sdfblend_row_tiled(sdfblend_tiles *t,
+                        long pos,
+                        const float *alpha,
+                        int n,
+                        struct vec3 clr,
+                        int mode);
+
+/* Linearise nrows rows from y into dst, in the tiles' format
+ * with stride pixels per row, ready for sdfwrite_rows and the
+ * like. A row copies tile by tile with memcpy.
+ */
+void sdfblend_tiles_rows(const sdfblend_tiles *t,
+                         int y,
+                         int nrows,
+                         void *dst,
+                         int stride);
+
+/* n pixels to packed 8-bit rgb. Float channels are scaled by
+ * 255 and truncated, clamped to [0, 255].
+ */
+void sdfblend_rgb8(unsigned char *out, const void *src, int format, int n);
+
+/* transfer curves for quantising */
+enum {
+    SDFBLEND_LINEAR,
+    SDFBLEND_SRGB
+};
+
+/* quantiser table entries, over [0, 1] */
+#define SDFBLEND_QUANT_BITS 14
+
+/* A table from channel value to 8-bit code in 8.8 fixed
+ * point, through a transfer curve. With dither, the fraction
+ * is rounded against a 4x4 ordered pattern instead of at one
+ * half.
+ */
+typedef struct {
+    unsigned short lut[1 << SDFBLEND_QUANT_BITS];
+    int dither;
+} sdfblend_quant;
+
+void sdfblend_quant_init(sdfblend_quant *q, int transfer, int dither);
+
+/* sdfblend_rgb8 through q, for the n pixels starting at
+ * (x, y) in the image, which place the dither pattern
+ */
+void sdfblend_rgb8_quant(unsigned char *out,
+                         const void *src,
+                         int format,
+                         int n,
+                         const sdfblend_quant *q,
+                         int x,
+                         int y);
+
+int sdfblend_find(const char *name);
+const char *sdfblend_name(int mode);
+#endif
@@ -0,0 +1,786 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfvm.h"
+#include "sdfblend.h"
+#include "sdfrender.h"
+#define SDF2D_SDFCMD_PRIV
+#include "sdfcmd.h"
+
+/* user data copies are kept this aligned */
+#define ALIGN 16
+
+size_t sdfcmd_sizeof(void)
+{
+    return sizeof(sdfcmd);
+}
+
+void sdfcmd_init(sdfcmd *c)
+{
+    c->items = NULL;
+    c->nitems = 0;
+    c->maxitems = 0;
+    c->data = NULL;
+    c->datasz = 0;
+    c->maxdata = 0;
+    c->buf = NULL;
+    c->format = SDFBLEND_RGBF;
+    c->width = 0;
+    c->height = 0;
+    c->stride = 0;
+    c->y0 = 0;
+    c->clear = 0;
+    c->bg = svec3_zero();
+    c->masked = 0;
+    c->mask = NULL;
+    c->maxmask = 0;
+    c->haveprev = 0;
+    c->prev = NULL;
+    c->nprev = 0;
+    c->maxprev = 0;
+    c->prevdata = NULL;
+    c->maxprevdata = 0;
+    c->prevbuf = NULL;
+    c->prevformat = 0;
+    c->prevwidth = 0;
+    c->prevheight = 0;
+    c->prevstride = 0;
+    c->ndirty = 0;
+    c->bandstart = NULL;
+    c->maxbands = 0;
+    c->bandlist = NULL;
+    c->maxbandlist = 0;
+    c->tiles_x = 0;
+    c->tiles_y = 0;
+    c->binstart = NULL;
+    c->cursor = NULL;
+    c->active = NULL;
+    c->maxtiles = 0;
+    c->bins = NULL;
+    c->maxbins = 0;
+    c->nactive = 0;
+    c->tile_fn = NULL;
+    c->tile_ud = NULL;
+}
+
+void sdfcmd_clean(sdfcmd *c)
+{
+    free(c->items);
+    free(c->data);
+    free(c->binstart);
+    free(c->cursor);
+    free(c->active);
+    free(c->bins);
+    free(c->bandstart);
+    free(c->bandlist);
+    free(c->mask);
+    free(c->prev);
+    free(c->prevdata);
+    sdfcmd_init(c);
+}
+
+void sdfcmd_reset(sdfcmd *c)
+{
+    c->nitems = 0;
+    c->datasz = 0;
+}
+
+int sdfcmd_count(sdfcmd *c)
+{
+    return c->nitems;
+}
+
+int sdfcmd_draw(sdfcmd *c,
+                const sdfrender_draw *dr,
+                const void *ud,
+                size_t udsz)
+{
+    sdfcmd_item *it;
+
+    if (dr->dist == NULL) return SDFCMD_NOT_OK;
+
+    if (c->nitems >= c->maxitems) {
+        int n;
+        sdfcmd_item *tmp;
+        n = c->maxitems ? c->maxitems * 2 : 64;
+        tmp = realloc(c->items, n * sizeof(sdfcmd_item));
+        if (tmp == NULL) return SDFCMD_NOT_OK;
+        c->items = tmp;
+        c->maxitems = n;
+    }
+
+    it = &c->items[c->nitems];
+    it->dr = *dr;
+    it->udoff = -1;
+    it->udsz = udsz;
+    it->ry = dr->region.y;
+    it->rcy = dr->clip.y;
+
+    if (udsz > 0) {
+        size_t off;
+
+        off = (c->datasz + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+
+        if (off + udsz > c->maxdata) {
+            size_t n;
+            unsigned char *tmp;
+            n = c->maxdata ? c->maxdata * 2 : 1024;
+            while (n < off + udsz) n *= 2;
+            tmp = realloc(c->data, n);
+            if (tmp == NULL) return SDFCMD_NOT_OK;
+            c->data = tmp;
+            c->maxdata = n;
+        }
+
+        memcpy(c->data + off, ud, udsz);
+        it->udoff = off;
+        c->datasz = off + udsz;
+    } else {
+        it->dr.ud = (void *)ud;
+    }
+
+    c->nitems++;
+
+    return SDFCMD_OK;
+}
+
+static int resize(int **p, int n)
+{
+    int *tmp;
+
+    tmp = realloc(*p, n * sizeof(int));
+    if (tmp == NULL) return 1;
+    *p = tmp;
+
+    return 0;
+}
+
+/* bin the n commands in list, or all of them if list is NULL */
+static int bin(sdfcmd *c, int width, int height, const int *list, int n)
+{
+    int i, k, t;
+    int ntiles;
+
+    c->tiles_x = (width + SDFRENDER_TILE - 1) / SDFRENDER_TILE;
+    c->tiles_y = (height + SDFRENDER_TILE - 1) / SDFRENDER_TILE;
+    ntiles = c->tiles_x * c->tiles_y;
+
+    if (ntiles + 1 > c->maxtiles) {
+        if (resize(&c->binstart, ntiles + 1)) return 1;
+        if (resize(&c->cursor, ntiles + 1)) return 1;
+        if (resize(&c->active, ntiles + 1)) return 1;
+        c->maxtiles = ntiles + 1;
+    }
+
+    for (t = 0; t <= ntiles; t++) c->binstart[t] = 0;
+
+    /* clip, then count */
+    for (k = 0; k < n; k++) {
+        sdfcmd_item *it;
+        int tx, ty;
+
+        it = &c->items[list != NULL ? list[k] : k];
+        if (!sdfrender_draw_bounds(&it->dr,
+                                   &it->cx0, &it->cy0,
+                                   &it->cx1, &it->cy1)) {
+            it->cx1 = it->cx0;
+            continue;
+        }
+
+        for (ty = it->cy0 / SDFRENDER_TILE;
+             ty <= (it->cy1 - 1) / SDFRENDER_TILE;
+             ty++) {
+            for (tx = it->cx0 / SDFRENDER_TILE;
+                 tx <= (it->cx1 - 1) / SDFRENDER_TILE;
+                 tx++) {
+                t = ty * c->tiles_x + tx;
+                if (c->masked && !c->mask[t]) continue;
+                c->binstart[t + 1]++;
+            }
+        }
+    }
+
+    c->nactive = 0;
+    for (t = 0; t < ntiles; t++) {
+        int on;
+        if (c->masked) on = c->mask[t];
+        else on = c->binstart[t + 1] > 0 || c->tile_fn != NULL;
+        if (on) c->active[c->nactive++] = t;
+        c->binstart[t + 1] += c->binstart[t];
+        c->cursor[t] = c->binstart[t];
+    }
+
+    if (c->binstart[ntiles] > c->maxbins) {
+        if (resize(&c->bins, c->binstart[ntiles])) return 1;
+        c->maxbins = c->binstart[ntiles];
+    }
+
+    /* fill, in recording order */
+    for (k = 0; k < n; k++) {
+        sdfcmd_item *it;
+        int tx, ty;
+
+        i = list != NULL ? list[k] : k;
+        it = &c->items[i];
+        if (it->cx1 <= it->cx0 || it->cy1 <= it->cy0) continue;
+
+        for (ty = it->cy0 / SDFRENDER_TILE;
+             ty <= (it->cy1 - 1) / SDFRENDER_TILE;
+             ty++) {
+            for (tx = it->cx0 / SDFRENDER_TILE;
+                 tx <= (it->cx1 - 1) / SDFRENDER_TILE;
+                 tx++) {
+                t = ty * c->tiles_x + tx;
+                if (c->masked && !c->mask[t]) continue;
+                c->bins[c->cursor[t]++] = i;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void render_bin(sdfrender_worker *w, void *ud, int item)
+{
+    sdfcmd *c;
+    int tile;
+    int tx0, ty0;
+    int k;
+
+    c = ud;
+    tile = c->active[item];
+    tx0 = (tile % c->tiles_x) * SDFRENDER_TILE;
+    ty0 = (tile / c->tiles_x) * SDFRENDER_TILE;
+
+    if (c->clear) {
+        int tx1, ty1;
+        tx1 = tx0 + SDFRENDER_TILE;
+        ty1 = ty0 + SDFRENDER_TILE;
+        if (tx1 > c->width) tx1 = c->width;
+        if (ty1 > c->height) ty1 = c->height;
+        sdfblend_fill_rect(c->buf, c->format, c->stride,
+                           tx0, ty0, tx1, ty1, c->bg);
+    }
+
+    for (k = c->binstart[tile]; k < c->binstart[tile + 1]; k++) {
+        sdfcmd_item *it;
+        int x0, y0, x1, y1;
+
+        it = &c->items[c->bins[k]];
+
+        x0 = it->cx0 > tx0 ? it->cx0 : tx0;
+        y0 = it->cy0 > ty0 ? it->cy0 : ty0;
+        x1 = it->cx1 < tx0 + SDFRENDER_TILE ? it->cx1 : tx0 + SDFRENDER_TILE;
+        y1 = it->cy1 < ty0 + SDFRENDER_TILE ? it->cy1 : ty0 + SDFRENDER_TILE;
+
+        sdfrender_rect(w, &it->dr, x0, y0, x1, y1);
+    }
+
+    if (c->tile_fn != NULL) {
+        int tx1, ty1;
+        tx1 = tx0 + SDFRENDER_TILE;
+        ty1 = ty0 + SDFRENDER_TILE;
+        if (tx1 > c->width) tx1 = c->width;
+        if (ty1 > c->height) ty1 = c->height;
+        c->tile_fn(c->tile_ud, tx0, c->y0 + ty0, tx1, c->y0 + ty1);
+    }
+}
+
+void sdfcmd_on_tile(sdfcmd *c, sdfcmd_tile_fn fn, void *ud)
+{
+    c->tile_fn = fn;
+    c->tile_ud = ud;
+}
+
+/* point every command at the canvas, for a whole frame */
+static void target(sdfcmd *c,
+                   void *buf,
+                   int format,
+                   int width,
+                   int height,
+                   int stride)
+{
+    int i;
+
+    for (i = 0; i < c->nitems; i++) {
+        sdfcmd_item *it;
+        it = &c->items[i];
+        it->dr.buf = buf;
+        it->dr.format = format;
+        it->dr.width = width;
+        it->dr.height = height;
+        it->dr.stride = stride;
+        it->dr.region.y = it->ry;
+        it->dr.clip.y = it->rcy;
+        if (it->udoff >= 0) it->dr.ud = c->data + it->udoff;
+    }
+
+    c->buf = buf;
+    c->format = format;
+    c->width = width;
+    c->height = height;
+    c->stride = stride;
+    c->y0 = 0;
+}
+
+int sdfcmd_submit(sdfcmd *c,
+                  sdfrender *r,
+                  void *buf,
+                  int format,
+                  int width,
+                  int height,
+                  int stride,
+                  unsigned long *fence)
+{
+    int rc;
+
+    *fence = sdfrender_fence(r);
+
+    c->haveprev = 0;
+
+    if (c->nitems == 0 && c->tile_fn == NULL) return SDFCMD_OK;
+
+    target(c, buf, format, width, height, stride);
+    c->clear = 0;
+    c->masked = 0;
+
+    if (bin(c, width, height, NULL, c->nitems)) return SDFCMD_NOT_OK;
+
+    rc = sdfrender_submit_task(r, render_bin, c, c->nactive);
+    if (rc) return SDFCMD_NOT_OK;
+
+    *fence = sdfrender_fence(r);
+
+    return SDFCMD_OK;
+}
+
+int sdfcmd_render(sdfcmd *c,
+                  sdfrender *r,
+                  void *buf,
+                  int format,
+                  int width,
+                  int height,
+                  int stride)
+{
+    unsigned long fence;
+    int rc;
+
+    rc = sdfcmd_submit(c, r, buf, format, width, height, stride, &fence);
+    if (rc) return rc;
+    sdfrender_wait(r, fence);
+
+    return SDFCMD_OK;
+}
+
+/* bin every command into the bands it overlaps, in recording order */
+static int bin_bands(sdfcmd *c, int width, int height, int band)
+{
+    int nbands;
+    int i, b;
+
+    nbands = (height + band - 1) / band;
+
+    if (nbands + 1 > c->maxbands) {
+        if (resize(&c->bandstart, nbands + 1)) return 1;
+        c->maxbands = nbands + 1;
+    }
+
+    for (b = 0; b <= nbands; b++) c->bandstart[b] = 0;
+
+    for (i = 0; i < c->nitems; i++) {
+        sdfcmd_item *it;
+
+        it = &c->items[i];
+        it->dr.width = width;
+        it->dr.height = height;
+        it->dr.region.y = it->ry;
+        it->dr.clip.y = it->rcy;
+
+        if (!sdfrender_draw_bounds(&it->dr,
+                                   &it->cx0, &it->cy0,
+                                   &it->cx1, &it->cy1)) {
+            it->cy1 = it->cy0;
+            continue;
+        }
+
+        for (b = it->cy0 / band; b <= (it->cy1 - 1) / band; b++) {
+            c->bandstart[b + 1]++;
+        }
+    }
+
+    for (b = 0; b < nbands; b++) c->bandstart[b + 1] += c->bandstart[b];
+
+    if (c->bandstart[nbands] > c->maxbandlist) {
+        if (resize(&c->bandlist, c->bandstart[nbands])) return 1;
+        c->maxbandlist = c->bandstart[nbands];
+    }
+
+    /* the counts become cursors, and then the ends */
+    for (i = 0; i < c->nitems; i++) {
+        sdfcmd_item *it;
+
+        it = &c->items[i];
+        if (it->cy1 <= it->cy0) continue;
+
+        for (b = it->cy0 / band; b <= (it->cy1 - 1) / band; b++) {
+            c->bandlist[c->bandstart[b]++] = i;
+        }
+    }
+
+    for (b = nbands; b > 0; b--) c->bandstart[b] = c->bandstart[b - 1];
+    c->bandstart[0] = 0;
+
+    return 0;
+}
+
+int sdfcmd_render_bands(sdfcmd *c,
+                        sdfrender *r,
+                        void *buf,
+                        int format,
+                        int width,
+                        int height,
+                        int stride,
+                        int band,
+                        struct vec3 bg,
+                        sdfcmd_band_fn fn,
+                        void *ud)
+{
+    int b, nbands;
+
+    if (band <= 0 || width <= 0 || height <= 0) return SDFCMD_NOT_OK;
+
+    c->haveprev = 0;
+    c->clear = 0;
+    c->masked = 0;
+
+    if (bin_bands(c, width, height, band)) return SDFCMD_NOT_OK;
+
+    nbands = (height + band - 1) / band;
+
+    for (b = 0; b < nbands; b++) {
+        int y0, nrows;
+        int *list;
+        int n;
+        int k;
+
+        y0 = b * band;
+        nrows = height - y0 < band ? height - y0 : band;
+
+        if (format == SDFBLEND_PLANAR) {
+            sdfblend_planes_fill(buf, bg);
+        } else if (format == SDFBLEND_TILED) {
+            sdfblend_tiles_fill(buf, bg);
+        } else {
+            int y;
+            for (y = 0; y < nrows; y++) {
+                sdfblend_fill_format(sdfblend_pixel(buf, format,
+                                                    (long)y * stride),
+                                     format, width, bg);
+            }
+        }
+
+        list = c->bandlist + c->bandstart[b];
+        n = c->bandstart[b + 1] - c->bandstart[b];
+
+        /* the band is a frame of its own, nrows tall */
+        for (k = 0; k < n; k++) {
+            sdfcmd_item *it;
+            it = &c->items[list[k]];
+            it->dr.buf = buf;
+            it->dr.format = format;
+            it->dr.width = width;
+            it->dr.height = nrows;
+            it->dr.stride = stride;
+            it->dr.region.y = it->ry - y0;
+            it->dr.clip.y = it->rcy - y0;
+            if (it->udoff >= 0) it->dr.ud = c->data + it->udoff;
+        }
+
+        c->width = width;
+        c->height = nrows;
+        c->y0 = y0;
+
+        if (n > 0 || c->tile_fn != NULL) {
+            unsigned long fence;
+
+            if (bin(c, width, nrows, list, n)) return SDFCMD_NOT_OK;
+            if (sdfrender_submit_task(r, render_bin, c, c->nactive)) {
+                return SDFCMD_NOT_OK;
+            }
+            fence = sdfrender_fence(r);
+            sdfrender_wait(r, fence);
+        }
+
+        if (fn != NULL && fn(ud, buf, y0, nrows)) return SDFCMD_NOT_OK;
+    }
+
+    return SDFCMD_OK;
+}
+
+/* same draw, target aside */
+static int same(const sdfcmd *c, const sdfcmd_item *a, const sdfcmd_item *b)
+{
+    const sdfrender_draw *da, *db;
+
+    da = &a->dr;
+    db = &b->dr;
+
+    if (da->dist != db->dist ||
+        da->region.x != db->region.x || a->ry != b->ry ||
+        da->region.z != db->region.z || da->region.w != db->region.w ||
+        da->clip.x != db->clip.x || a->rcy != b->rcy ||
+        da->clip.z != db->clip.z || da->clip.w != db->clip.w ||
+        da->clr.x != db->clr.x ||
+        da->clr.y != db->clr.y ||
+        da->clr.z != db->clr.z ||
+        da->blend != db->blend ||
+        da->feather != db->feather ||
+        da->scale != db->scale ||
+        da->lipschitz != db->lipschitz ||
+        da->samples != db->samples ||
+        da->mask != db->mask ||
+        da->mask_w != db->mask_w || da->mask_h != db->mask_h) {
+        return 0;
+    }
+
+    if ((a->udoff >= 0) != (b->udoff >= 0)) return 0;
+
+    if (a->udoff < 0) return da->ud == db->ud;
+
+    return a->udsz == b->udsz &&
+        !memcmp(c->data + a->udoff, c->prevdata + b->udoff, a->udsz);
+}
+
+static long area(const sdfcmd_rect *r)
+{
+    return (long)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static sdfcmd_rect merged(const sdfcmd_rect *a, const sdfcmd_rect *b)
+{
+    sdfcmd_rect u;
+    u.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    u.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    u.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    u.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    return u;
+}
+
+/* Add pixel bounds, snapped out to tiles. Rectangles whose
+ * union costs no more than the two apart are merged; past
+ * SDFCMD_MAXDIRTY the pair that wastes least is.
+ */
+static void add_dirty(sdfcmd *c, int x0, int y0, int x1, int y1)
+{
+    sdfcmd_rect d;
+    int i, j;
+    int bi, bj;
+    long best;
+
+    if (x1 <= x0 || y1 <= y0) return;
+
+    d.x0 = x0 / SDFRENDER_TILE * SDFRENDER_TILE;
+    d.y0 = y0 / SDFRENDER_TILE * SDFRENDER_TILE;
+    d.x1 = (x1 + SDFRENDER_TILE - 1) / SDFRENDER_TILE * SDFRENDER_TILE;
+    d.y1 = (y1 + SDFRENDER_TILE - 1) / SDFRENDER_TILE * SDFRENDER_TILE;
+    if (d.x1 > c->width) d.x1 = c->width;
+    if (d.y1 > c->height) d.y1 = c->height;
+
+    for (i = 0; i < c->ndirty; ) {
+        sdfcmd_rect u;
+        u = merged(&c->dirty[i], &d);
+        if (area(&u) <= area(&c->dirty[i]) + area(&d)) {
+            d = u;
+            c->dirty[i] = c->dirty[--c->ndirty];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    c->dirty[c->ndirty++] = d;
+
+    if (c->ndirty <= SDFCMD_MAXDIRTY) return;
+
+    bi = 0;
+    bj = 1;
+    best = -1;
+    for (i = 0; i < c->ndirty; i++) {
+        for (j = i + 1; j < c->ndirty; j++) {
+            sdfcmd_rect u;
+            long waste;
+            u = merged(&c->dirty[i], &c->dirty[j]);
+            waste = area(&u) - area(&c->dirty[i]) - area(&c->dirty[j]);
+            if (best < 0 || waste < best) {
+                best = waste;
+                bi = i;
+                bj = j;
+            }
+        }
+    }
+
+    c->dirty[bi] = merged(&c->dirty[bi], &c->dirty[bj]);
+    c->dirty[bj] = c->dirty[--c->ndirty];
+}
+
+/* keep this frame's list to compare the next one against */
+static int snapshot(sdfcmd *c)
+{
+    if (c->nitems > c->maxprev) {
+        sdfcmd_item *tmp;
+        tmp = realloc(c->prev, c->nitems * sizeof(sdfcmd_item));
+        if (tmp == NULL) return 1;
+        c->prev = tmp;
+        c->maxprev = c->nitems;
+    }
+
+    if (c->datasz > c->maxprevdata) {
+        unsigned char *tmp;
+        tmp = realloc(c->prevdata, c->datasz);
+        if (tmp == NULL) return 1;
+        c->prevdata = tmp;
+        c->maxprevdata = c->datasz;
+    }
+
+    if (c->nitems > 0) {
+        memcpy(c->prev, c->items, c->nitems * sizeof(sdfcmd_item));
+    }
+    if (c->datasz > 0) memcpy(c->prevdata, c->data, c->datasz);
+
+    c->nprev = c->nitems;
+    c->prevbuf = c->buf;
+    c->prevformat = c->format;
+    c->prevwidth = c->width;
+    c->prevheight = c->height;
+    c->prevstride = c->stride;
+    c->haveprev = 1;
+
+    return 0;
+}
+
+int sdfcmd_render_dirty(sdfcmd *c,
+                        sdfrender *r,
+                        void *buf,
+                        int format,
+                        int width,
+                        int height,
+                        int stride,
+                        struct vec3 bg)
+{
+    int i, k, n;
+    int ntiles;
+    int dirty;
+
+    if (width <= 0 || height <= 0) return SDFCMD_NOT_OK;
+
+    target(c, buf, format, width, height, stride);
+    c->ndirty = 0;
+
+    if (!c->haveprev ||
+        c->prevbuf != buf || c->prevformat != format ||
+        c->prevwidth != width || c->prevheight != height ||
+        c->prevstride != stride ||
+        c->bg.x != bg.x || c->bg.y != bg.y || c->bg.z != bg.z) {
+        add_dirty(c, 0, 0, width, height);
+    } else {
+        n = c->nitems > c->nprev ? c->nitems : c->nprev;
+
+        for (i = 0; i < n; i++) {
+            sdfcmd_item *it, *old;
+
+            it = i < c->nitems ? &c->items[i] : NULL;
+            old = i < c->nprev ? &c->prev[i] : NULL;
+
+            if (it != NULL) {
+                if (!sdfrender_draw_bounds(&it->dr,
+                                           &it->cx0, &it->cy0,
+                                           &it->cx1, &it->cy1)) {
+                    it->cx1 = it->cx0;
+                }
+            }
+
+            if (it != NULL && old != NULL && same(c, it, old)) continue;
+
+            if (it != NULL) add_dirty(c, it->cx0, it->cy0, it->cx1, it->cy1);
+            if (old != NULL) {
+                add_dirty(c, old->cx0, old->cy0, old->cx1, old->cy1);
+            }
+        }
+    }
+
+    c->bg = bg;
+    c->clear = 1;
+    c->masked = 1;
+
+    ntiles = ((width + SDFRENDER_TILE - 1) / SDFRENDER_TILE) *
+             ((height + SDFRENDER_TILE - 1) / SDFRENDER_TILE);
+
+    if (ntiles > c->maxmask) {
+        unsigned char *tmp;
+        tmp = realloc(c->mask, ntiles);
+        if (tmp == NULL) return SDFCMD_NOT_OK;
+        c->mask = tmp;
+        c->maxmask = ntiles;
+    }
+
+    memset(c->mask, 0, ntiles);
+    dirty = 0;
+
+    for (k = 0; k < c->ndirty; k++) {
+        const sdfcmd_rect *d;
+        int tx, ty, tiles_x;
+
+        d = &c->dirty[k];
+        tiles_x = (width + SDFRENDER_TILE - 1) / SDFRENDER_TILE;
+
+        for (ty = d->y0 / SDFRENDER_TILE;
+             ty <= (d->y1 - 1) / SDFRENDER_TILE;
+             ty++) {
+            for (tx = d->x0 / SDFRENDER_TILE;
+                 tx <= (d->x1 - 1) / SDFRENDER_TILE;
+                 tx++) {
+                c->mask[ty * tiles_x + tx] = 1;
+                dirty = 1;
+            }
+        }
+    }
+
+    if (dirty) {
+        unsigned long fence;
+
+        if (bin(c, width, height, NULL, c->nitems) ||
+            sdfrender_submit_task(r, render_bin, c, c->nactive)) {
+            c->masked = 0;
+            c->clear = 0;
+            c->haveprev = 0;
+            return SDFCMD_NOT_OK;
+        }
+
+        fence = sdfrender_fence(r);
+        sdfrender_wait(r, fence);
+    }
+
+    c->masked = 0;
+    c->clear = 0;
+
+    if (snapshot(c)) {
+        c->haveprev = 0;
+        return SDFCMD_NOT_OK;
+    }
+
+    return SDFCMD_OK;
+}
+
+int sdfcmd_dirty(sdfcmd *c, const sdfcmd_rect **rects)
+{
+    *rects = c->dirty;
+    return c->ndirty;
+}
+
+void sdfcmd_invalidate(sdfcmd *c)
+{
+    c->haveprev = 0;
+}
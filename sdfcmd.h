@@ -0,0 +1,213 @@
+#ifndef SDF2D_SDFCMD_H
+#define SDF2D_SDFCMD_H
+
+typedef struct sdfcmd sdfcmd;
+
+/* dirty rectangles kept per frame, more are merged */
+#define SDFCMD_MAXDIRTY 16
+
+enum {
+    SDFCMD_OK,
+    SDFCMD_NOT_OK
+};
+
+/* pixels [x0, x1) x [y0, y1) */
+typedef struct {
+    int x0, y0, x1, y1;
+} sdfcmd_rect;
+
+/* called on a worker thread once the pixel rectangle
+ * [x0, x1) x [y0, y1) of a frame is final
+ */
+typedef void (*sdfcmd_tile_fn)(void *ud, int x0, int y0, int x1, int y1);
+
+/* called on the rendering thread with each finished band of
+ * sdfcmd_render_bands, nrows rows starting on frame row y.
+ * Non-zero stops the frame.
+ */
+typedef int (*sdfcmd_band_fn)(void *ud, const void *buf, int y, int nrows);
+
+#ifdef SDF2D_SDFCMD_PRIV
+typedef struct {
+    sdfrender_draw dr;
+
+    /* pixel bounds, clipped to the canvas */
+    int cx0, cy0, cx1, cy1;
+
+    /* copied user data in the arena, -1 for none */
+    long udoff;
+    size_t udsz;
+
+    /* region and clip y as recorded, bands shift them */
+    float ry;
+    float rcy;
+} sdfcmd_item;
+
+struct sdfcmd {
+    sdfcmd_item *items;
+    int nitems;
+    int maxitems;
+
+    /* user data arena */
+    unsigned char *data;
+    size_t datasz;
+    size_t maxdata;
+
+    /* target of the frame in flight, and the frame row it
+     * starts on when rendering in bands
+     */
+    void *buf;
+    int format;
+    int width;
+    int height;
+    int stride;
+    int y0;
+
+    /* dirty frames clear each tile to bg first, and only
+     * draw the tiles set in mask
+     */
+    int clear;
+    struct vec3 bg;
+    int masked;
+    unsigned char *mask;
+    int maxmask;
+
+    /* the list and target of the last dirty frame, which
+     * the pixels in prevbuf show. haveprev is 0 until there
+     * is one, or after anything else drew with the list.
+     */
+    int haveprev;
+    sdfcmd_item *prev;
+    int nprev;
+    int maxprev;
+    unsigned char *prevdata;
+    size_t maxprevdata;
+    void *prevbuf;
+    int prevformat;
+    int prevwidth;
+    int prevheight;
+    int prevstride;
+
+    sdfcmd_rect dirty[SDFCMD_MAXDIRTY + 1];
+    int ndirty;
+
+    /* commands overlapping band b are
+     * bandlist[bandstart[b]] .. bandlist[bandstart[b + 1] - 1]
+     */
+    int *bandstart;
+    int maxbands;
+    int *bandlist;
+    int maxbandlist;
+
+    /* bins: commands overlapping tile t, in recording order,
+     * are bins[binstart[t]] .. bins[binstart[t + 1] - 1]
+     */
+    int tiles_x;
+    int tiles_y;
+    int *binstart;
+    int *cursor;
+    int *active;
+    int maxtiles;
+    int *bins;
+    int maxbins;
+    int nactive;
+
+    sdfcmd_tile_fn tile_fn;
+    void *tile_ud;
+};
+#endif
+
+size_t sdfcmd_sizeof(void);
+void sdfcmd_init(sdfcmd *c);
+void sdfcmd_clean(sdfcmd *c);
+
+/* forget all commands, keeping the memory */
+void sdfcmd_reset(sdfcmd *c);
+int sdfcmd_count(sdfcmd *c);
+
+/* Record a draw. The target fields of dr are ignored. If
+ * udsz is non-zero, udsz bytes at ud are copied and the
+ * copy is what the distance function sees as dr->ud.
+ */
+int sdfcmd_draw(sdfcmd *c,
+                const sdfrender_draw *dr,
+                const void *ud,
+                size_t udsz);
+
+/* Report every tile of the frame, empty ones included, to fn
+ * as it completes. NULL turns it off.
+ */
+void sdfcmd_on_tile(sdfcmd *c, sdfcmd_tile_fn fn, void *ud);
+
+/* Bin the commands into tiles and queue every tile once, to
+ * composite its commands in recording order. Returns at once;
+ * the frame is done when the fence written to fence passes
+ * (see sdfrender_wait). Until then the list must not be
+ * changed, reset or rendered again, and buf belongs to the
+ * workers.
+ */
+int sdfcmd_submit(sdfcmd *c,
+                  sdfrender *r,
+                  void *buf,
+                  int format,
+                  int width,
+                  int height,
+                  int stride,
+                  unsigned long *fence);
+
+/* submit, then wait for the frame */
+int sdfcmd_render(sdfcmd *c,
+                  sdfrender *r,
+                  void *buf,
+                  int format,
+                  int width,
+                  int height,
+                  int stride);
+
+/* Render a frame height rows tall a band at a time, for
+ * frames too big to hold. buf holds band rows of width pixels,
+ * stride apart (a sdfblend_planes band rows tall if PLANAR).
+ * The commands are binned into bands once; then each band is
+ * cleared to bg, drawn, and handed to fn before the next, so
+ * memory is bounded by the band whatever the height.
+ */
+int sdfcmd_render_bands(sdfcmd *c,
+                        sdfrender *r,
+                        void *buf,
+                        int format,
+                        int width,
+                        int height,
+                        int stride,
+                        int band,
+                        struct vec3 bg,
+                        sdfcmd_band_fn fn,
+                        void *ud);
+
+/* Render the list into a canvas that still shows the last
+ * frame this drew there, redrawing only what changed. Commands
+ * are matched to the last frame's by position and compared by
+ * their draw fields and copied user data (user data that was
+ * not copied compares by pointer). The old and new bounds of
+ * those that differ, or were added or dropped, are snapped out
+ * to tiles and merged into at most SDFCMD_MAXDIRTY rectangles.
+ * Their tiles are cleared to bg and redrawn with every command
+ * overlapping them. The first frame, and one with a new target,
+ * is dirty everywhere. Waits for the frame.
+ */
+int sdfcmd_render_dirty(sdfcmd *c,
+                        sdfrender *r,
+                        void *buf,
+                        int format,
+                        int width,
+                        int height,
+                        int stride,
+                        struct vec3 bg);
+
+/* the dirty rectangles of the last dirty frame, for
+ * presenting just those. Returns how many.
+ */
+int sdfcmd_dirty(sdfcmd *c, const sdfcmd_rect **rects);
+
+/* forget the last dirty frame, so the next is redrawn whole */
+void sdfcmd_invalidate(sdfcmd *c);
+#endif
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "mathc/mathc.h"
+#include "sdfblend.h"
+#define SDF2D_SDFMAP_PRIV
+#include "sdfmap.h"
+
+size_t sdfmap_sizeof(void)
+{
+    return sizeof(sdfmap);
+}
+
+static int write_all(int fd, const void *p, size_t n)
+{
+    const unsigned char *c;
+
+    c = p;
+    while (n > 0) {
+        ssize_t k;
+        k = write(fd, c, n);
+        if (k <= 0) return SDFMAP_IO;
+        c += k;
+        n -= k;
+    }
+
+    return SDFMAP_OK;
+}
+
+int sdfmap_open(sdfmap *m,
+                const char *filename,
+                int width,
+                int height,
+                int format)
+{
+    size_t body;
+    int n;
+
+    m->fd = -1;
+    m->base = NULL;
+    m->heap = NULL;
+    m->status = SDFMAP_OK;
+    m->width = width;
+    m->height = height;
+    m->format = format;
+
+    if (width <= 0 || height <= 0) return SDFMAP_NOT_OK;
+
+    if (format == SDFBLEND_RGB8) {
+        n = sprintf(m->header, "P6\n%d %d\n255\n", width, height);
+    } else if (format == SDFBLEND_RGBA8) {
+        n = sprintf(m->header,
+                    "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\n"
+                    "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+                    width, height);
+    } else {
+        return SDFMAP_NOT_OK;
+    }
+
+    m->hdrsz = n;
+    body = (size_t)width * height * sdfblend_pixsize(format);
+    m->size = m->hdrsz + body;
+    m->pagesz = sysconf(_SC_PAGESIZE);
+    if (m->pagesz <= 0) m->pagesz = 4096;
+
+    m->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m->fd < 0) return SDFMAP_OPEN;
+
+    if (ftruncate(m->fd, m->size) == 0) {
+        void *p;
+        p = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+        if (p != MAP_FAILED) m->base = p;
+    }
+
+    if (m->base != NULL) {
+        memcpy(m->base, m->header, m->hdrsz);
+        /* rows are drawn in bands, mostly top to bottom */
+        madvise(m->base, m->size, MADV_SEQUENTIAL);
+        return SDFMAP_OK;
+    }
+
+    /* the heap path: the body is written at close */
+    m->heap = malloc(body);
+    if (m->heap == NULL) {
+        close(m->fd);
+        m->fd = -1;
+        return SDFMAP_NOT_OK;
+    }
+
+    return SDFMAP_OK;
+}
+
+void *sdfmap_pixels(sdfmap *m)
+{
+    if (m->base != NULL) return m->base + m->hdrsz;
+    return m->heap;
+}
+
+int sdfmap_mapped(sdfmap *m)
+{
+    return m->base != NULL;
+}
+
+int sdfmap_done(sdfmap *m, int y, int nrows)
+{
+    size_t rowsz;
+    size_t start, end;
+
+    if (m->base == NULL) return m->status;
+    if (y < 0 || nrows <= 0 || y + nrows > m->height) return SDFMAP_NOT_OK;
+
+    rowsz = (size_t)m->width * sdfblend_pixsize(m->format);
+    start = m->hdrsz + y * rowsz;
+    end = start + nrows * rowsz;
+
+    /* whole pages only, a page shared with unfinished rows stays */
+    start = (start + m->pagesz - 1) / m->pagesz * m->pagesz;
+    if (y + nrows < m->height) end = end / m->pagesz * m->pagesz;
+    else end = m->size;
+    if (end <= start) return m->status;
+
+    if (msync(m->base + start, end - start, MS_ASYNC)) {
+        if (m->status == SDFMAP_OK) m->status = SDFMAP_IO;
+    }
+
+    /* shared file pages keep their contents in the page cache */
+    madvise(m->base + start, end - start, MADV_DONTNEED);
+
+    return m->status;
+}
+
+int sdfmap_close(sdfmap *m)
+{
+    int status;
+
+    if (m->fd < 0) return SDFMAP_NOT_OK;
+
+    status = m->status;
+
+    if (m->base != NULL) {
+        if (msync(m->base, m->size, MS_SYNC) && status == SDFMAP_OK) {
+            status = SDFMAP_IO;
+        }
+        munmap(m->base, m->size);
+        m->base = NULL;
+    } else {
+        if (status == SDFMAP_OK) {
+            status = write_all(m->fd, m->header, m->hdrsz);
+        }
+        if (status == SDFMAP_OK) {
+            status = write_all(m->fd, m->heap, m->size - m->hdrsz);
+        }
+        free(m->heap);
+        m->heap = NULL;
+    }
+
+    if (close(m->fd) && status == SDFMAP_OK) status = SDFMAP_IO;
+    m->fd = -1;
+
+    return status;
+}
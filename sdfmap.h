@@ -0,0 +1,62 @@
+#ifndef SDF2D_SDFMAP_H
+#define SDF2D_SDFMAP_H
+
+typedef struct sdfmap sdfmap;
+
+enum {
+    SDFMAP_OK,
+    SDFMAP_NOT_OK,
+    SDFMAP_OPEN,
+    SDFMAP_IO
+};
+
+#ifdef SDF2D_SDFMAP_PRIV
+struct sdfmap {
+    int fd;
+    int width;
+    int height;
+    int format;
+
+    /* the header, and the file size with the body after it */
+    char header[128];
+    size_t hdrsz;
+    size_t size;
+
+    /* the whole file mapped, or NULL and the body on the heap */
+    unsigned char *base;
+    unsigned char *heap;
+    long pagesz;
+
+    int status;
+};
+#endif
+
+size_t sdfmap_sizeof(void);
+
+/* A canvas that is the body of an image file. SDFBLEND_RGB8
+ * makes a binary PPM, SDFBLEND_RGBA8 a PAM with alpha. The
+ * header is written first and the body mapped in after it, so
+ * draws write final pixels straight to the page cache. If the
+ * file cannot be mapped the body lives on the heap and is
+ * written out by sdfmap_close.
+ */
+int sdfmap_open(sdfmap *m,
+                const char *filename,
+                int width,
+                int height,
+                int format);
+
+/* pixels, width apart, in the format given to sdfmap_open */
+void *sdfmap_pixels(sdfmap *m);
+
+/* non-zero if the body is mapped, not on the heap */
+int sdfmap_mapped(sdfmap *m);
+
+/* Rows [y, y + nrows) are final: start writing them back and
+ * let their pages go. Optional, for images bigger than memory.
+ */
+int sdfmap_done(sdfmap *m, int y, int nrows);
+
+/* flush everything, unmap and close */
+int sdfmap_close(sdfmap *m);
+#endif
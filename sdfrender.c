@@ -0,0 +1,1246 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfvm.h"
+#include "sdfblend.h"
+#define SDF2D_SDFRENDER_PRIV
+#include "sdfrender.h"
+
+size_t sdfrender_sizeof(void)
+{
+    return sizeof(sdfrender);
+}
+
+void sdfrender_draw_init(sdfrender_draw *dr)
+{
+    dr->buf = NULL;
+    dr->format = SDFBLEND_RGBF;
+    dr->width = 0;
+    dr->height = 0;
+    dr->stride = 0;
+    dr->region = svec4_zero();
+    dr->clip = svec4_zero();
+    dr->dist = NULL;
+    dr->ud = NULL;
+    dr->clr = svec3_zero();
+    dr->blend = SDFBLEND_MIX;
+    dr->feather = 0;
+    dr->scale = 0;
+    dr->lipschitz = 0;
+    dr->samples = 1;
+    dr->mask = NULL;
+    dr->mask_w = 0;
+    dr->mask_h = 0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Pixels whose centre distance is within this of the edge
+ * are supersampled, zero when supersampling is off. It is one
+ * pixel in distance units, so it needs the scale.
+ */
+static float aa_band(const sdfrender_draw *dr)
+{
+    if (dr->samples < 2 || dr->scale <= 0) return 0;
+    return dr->scale * (dr->lipschitz > 0 ? dr->lipschitz : 1);
+}
+
+/* mean coverage of an N x N grid over the pixel at st */
+static float supersample(sdfrender_worker *w,
+                         const sdfrender_draw *dr,
+                         struct vec2 st)
+{
+    float sub[SDFRENDER_MAXSAMPLES * SDFRENDER_MAXSAMPLES];
+    float step, off, sum;
+    int n, i, j;
+
+    n = dr->samples;
+    if (n > SDFRENDER_MAXSAMPLES) n = SDFRENDER_MAXSAMPLES;
+    step = 1.0f / n;
+    off = 0.5f * step - 0.5f;
+
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < n; i++) {
+            sub[j*n + i] = dr->dist(svec2(st.x + off + i*step,
+                                          st.y + off + j*step),
+                                    dr, w);
+        }
+    }
+
+    sdfblend_coverage(sub, sub, n*n, dr->feather);
+
+    sum = 0;
+    for (i = 0; i < n*n; i++) sum += sub[i];
+
+    w->stats.samples += n*n;
+    w->stats.supersampled++;
+
+    return sum * step * step;
+}
+
+/* blend n pixels of coverage into the canvas at pos */
+static void blend_run(const sdfrender_draw *dr,
+                      long pos,
+                      const float *alpha,
+                      int n)
+{
+    if (dr->format == SDFBLEND_PLANAR) {
+        sdfblend_row_planar(dr->buf, pos, alpha, n, dr->clr, dr->blend);
+        return;
+    }
+
+    if (dr->format == SDFBLEND_TILED) {
+        sdfblend_row_tiled(dr->buf, pos, alpha, n, dr->clr, dr->blend);
+        return;
+    }
+
+    sdfblend_row_format(sdfblend_pixel(dr->buf, dr->format, pos),
+                        dr->format, alpha, n, dr->clr, dr->blend);
+}
+
+/* evaluate and blend [x0, x1) of row y */
+static void row_eval(sdfrender_worker *w,
+                     const sdfrender_draw *dr,
+                     int y, int x0, int x1)
+{
+    const struct vec4 *reg;
+    float band, edge;
+    int x;
+
+    reg = &dr->region;
+    band = aa_band(dr);
+    edge = dr->feather > 0 ? dr->feather : 0;
+
+    for (x = x0; x < x1; x += SDFBLEND_CHUNK) {
+        int i, n;
+
+        n = x1 - x;
+        if (n > SDFBLEND_CHUNK) n = SDFBLEND_CHUNK;
+
+        for (i = 0; i < n; i++) {
+            w->d[i] = dr->dist(svec2(x + i - reg->x, y - reg->y), dr, w);
+        }
+
+        w->stats.pixels += n;
+        w->stats.samples += n;
+
+        if (band <= 0) {
+            sdfblend_coverage(w->d, w->d, n, dr->feather);
+            blend_run(dr, (long)y*dr->stride + x, w->d, n);
+            continue;
+        }
+
+        sdfblend_coverage(w->a, w->d, n, dr->feather);
+
+        for (i = 0; i < n; i++) {
+            if (w->d[i] > -band && w->d[i] < edge + band) {
+                w->a[i] = supersample(w, dr,
+                                      svec2(x + i - reg->x, y - reg->y));
+            }
+        }
+
+        blend_run(dr, (long)y*dr->stride + x, w->a, n);
+    }
+}
+
+/* blend [x0, x1) of row y at full coverage */
+static void row_fill(sdfrender_worker *w,
+                     const sdfrender_draw *dr,
+                     int y, int x0, int x1)
+{
+    int x;
+    int i;
+
+    for (i = 0; i < SDFBLEND_CHUNK; i++) w->d[i] = 1;
+
+    for (x = x0; x < x1; x += SDFBLEND_CHUNK) {
+        int n;
+
+        n = x1 - x;
+        if (n > SDFBLEND_CHUNK) n = SDFBLEND_CHUNK;
+
+        blend_run(dr, (long)y*dr->stride + x, w->d, n);
+        w->stats.pixels += n;
+        w->stats.culled += n;
+    }
+}
+
+/* the rectangle is already clipped to the canvas */
+static void rows(sdfrender_worker *w,
+                 const sdfrender_draw *dr,
+                 int x0, int y0,
+                 int x1, int y1,
+                 int fill)
+{
+    int y;
+
+    for (y = y0; y < y1; y++) {
+        if (fill) row_fill(w, dr, y, x0, x1);
+        else row_eval(w, dr, y, x0, x1);
+    }
+}
+
+/* Quadtree over the rectangle. One sample at the centre of a
+ * node bounds the distance everywhere in it, since the field
+ * changes by at most lipschitz * scale per pixel. Nodes that
+ * are entirely outside the falloff are skipped, nodes entirely
+ * inside are filled, the rest are split.
+ */
+static void cull_rect(sdfrender_worker *w,
+                      const sdfrender_draw *dr,
+                      int x0, int y0,
+                      int x1, int y1)
+{
+    float cx, cy;
+    float hw, hh;
+    float d, bound;
+    float edge, band;
+    int xm, ym;
+
+    if (x1 - x0 <= SDFRENDER_CULL_LEAF && y1 - y0 <= SDFRENDER_CULL_LEAF) {
+        rows(w, dr, x0, y0, x1, y1, 0);
+        return;
+    }
+
+    /* centre and half extent of the pixels sampled */
+    cx = 0.5f * (x0 + x1 - 1);
+    cy = 0.5f * (y0 + y1 - 1);
+    hw = 0.5f * (x1 - x0 - 1);
+    hh = 0.5f * (y1 - y0 - 1);
+
+    d = dr->dist(svec2(cx - dr->region.x, cy - dr->region.y), dr, w);
+    w->stats.samples++;
+
+    /* a little slack for rounding in the distance functions */
+    bound = dr->lipschitz * dr->scale * sqrt(hw*hw + hh*hh);
+    bound = bound * 1.001f + 1e-5f;
+
+    /* supersampled pixels need their band clear of the block */
+    edge = dr->feather > 0 ? dr->feather : 0;
+    band = aa_band(dr);
+
+    if (d - bound >= edge + band) {
+        w->stats.culled += (x1 - x0) * (y1 - y0);
+        return;
+    }
+
+    if (d + bound < -band) {
+        rows(w, dr, x0, y0, x1, y1, 1);
+        return;
+    }
+
+    xm = (x0 + x1) / 2;
+    ym = (y0 + y1) / 2;
+
+    if (x1 - x0 <= SDFRENDER_CULL_LEAF) {
+        cull_rect(w, dr, x0, y0, x1, ym);
+        cull_rect(w, dr, x0, ym, x1, y1);
+    } else if (y1 - y0 <= SDFRENDER_CULL_LEAF) {
+        cull_rect(w, dr, x0, y0, xm, y1);
+        cull_rect(w, dr, xm, y0, x1, y1);
+    } else {
+        cull_rect(w, dr, x0, y0, xm, ym);
+        cull_rect(w, dr, xm, y0, x1, ym);
+        cull_rect(w, dr, x0, ym, xm, y1);
+        cull_rect(w, dr, xm, ym, x1, y1);
+    }
+}
+
+int sdfrender_draw_bounds(const sdfrender_draw *dr,
+                          int *x0, int *y0,
+                          int *x1, int *y1)
+{
+    const struct vec4 *reg;
+    const struct vec4 *clip;
+
+    reg = &dr->region;
+    clip = &dr->clip;
+
+    *x0 = reg->x;
+    *x1 = reg->z + reg->x;
+    *y0 = reg->y;
+    *y1 = reg->w + reg->y;
+
+    if (clip->z > 0 && clip->w > 0) {
+        int c;
+        c = floor(clip->x);
+        if (c > *x0) *x0 = c;
+        c = ceil(clip->x + clip->z);
+        if (c < *x1) *x1 = c;
+        c = floor(clip->y);
+        if (c > *y0) *y0 = c;
+        c = ceil(clip->y + clip->w);
+        if (c < *y1) *y1 = c;
+    }
+
+    if (*x0 < 0) *x0 = 0;
+    if (*y0 < 0) *y0 = 0;
+    if (*x1 > dr->width) *x1 = dr->width;
+    if (*y1 > dr->height) *y1 = dr->height;
+
+    return *x1 > *x0 && *y1 > *y0;
+}
+
+void sdfrender_draw_aabb(sdfrender_draw *dr, struct vec2 lo, struct vec2 hi)
+{
+    const struct vec4 *reg;
+    float half;
+    float m;
+
+    reg = &dr->region;
+
+    /* p = (2st - res) / res.y, so a unit is half the height */
+    half = 0.5f * reg->w;
+
+    /* the falloff, supersampling and a pixel for rounding */
+    m = 1;
+    if (dr->feather > 0) m += dr->feather * half;
+    if (dr->samples > 1) m += 1;
+
+    dr->clip.x = reg->x + lo.x * half + 0.5f * reg->z - m;
+    dr->clip.y = reg->y + lo.y * half + half - m;
+    dr->clip.z = (hi.x - lo.x) * half + 2 * m;
+    dr->clip.w = (hi.y - lo.y) * half + 2 * m;
+}
+
+/* blend the draw's mask over the rectangle, already clipped */
+static void blit(sdfrender_worker *w,
+                 const sdfrender_draw *dr,
+                 int x0, int y0,
+                 int x1, int y1)
+{
+    int mx, my;
+    int x, y;
+
+    mx = floor(dr->region.x);
+    my = floor(dr->region.y);
+
+    if (x0 < mx) x0 = mx;
+    if (y0 < my) y0 = my;
+    if (x1 > mx + dr->mask_w) x1 = mx + dr->mask_w;
+    if (y1 > my + dr->mask_h) y1 = my + dr->mask_h;
+
+    for (y = y0; y < y1; y++) {
+        const float *row;
+
+        row = dr->mask + (long)(y - my) * dr->mask_w;
+
+        for (x = x0; x < x1; x += SDFBLEND_CHUNK) {
+            int n;
+
+            n = x1 - x;
+            if (n > SDFBLEND_CHUNK) n = SDFBLEND_CHUNK;
+
+            blend_run(dr, (long)y*dr->stride + x, row + (x - mx), n);
+            w->stats.pixels += n;
+        }
+    }
+}
+
+void sdfrender_rect(sdfrender_worker *w,
+                    const sdfrender_draw *dr,
+                    int xstart, int ystart,
+                    int xend, int yend)
+{
+    int x0, y0, x1, y1;
+
+    if (!sdfrender_draw_bounds(dr, &x0, &y0, &x1, &y1)) return;
+
+    if (xstart > x0) x0 = xstart;
+    if (ystart > y0) y0 = ystart;
+    if (xend < x1) x1 = xend;
+    if (yend < y1) y1 = yend;
+    if (x1 <= x0 || y1 <= y0) return;
+
+    if (dr->mask != NULL) {
+        blit(w, dr, x0, y0, x1, y1);
+    } else if (dr->lipschitz > 0 && dr->scale > 0) {
+        cull_rect(w, dr, x0, y0, x1, y1);
+    } else {
+        rows(w, dr, x0, y0, x1, y1, 0);
+    }
+}
+
+static void run_item(sdfrender_worker *w,
+                     const sdfrender_job *job,
+                     int item)
+{
+    double t;
+
+    t = now();
+
+    if (job->task != NULL) {
+        job->task(w, job->ud, item);
+    } else {
+        int x0, y0, x1, y1;
+        x0 = job->x0 + (item % job->tiles_x) * SDFRENDER_TILE;
+        y0 = job->y0 + (item / job->tiles_x) * SDFRENDER_TILE;
+        x1 = x0 + SDFRENDER_TILE;
+        y1 = y0 + SDFRENDER_TILE;
+        if (x1 > job->x1) x1 = job->x1;
+        if (y1 > job->y1) y1 = job->y1;
+        sdfrender_rect(w, &job->dr, x0, y0, x1, y1);
+    }
+
+    w->stats.tiles++;
+    w->stats.busy += now() - t;
+}
+
+static void job_setup(sdfrender_job *job, const sdfrender_draw *dr)
+{
+    int tiles_y;
+
+    job->dr = *dr;
+    job->task = NULL;
+    job->ud = NULL;
+    job->done = 0;
+
+    job->tiles_x = 0;
+    job->ntiles = 0;
+
+    if (!sdfrender_draw_bounds(dr, &job->x0, &job->y0, &job->x1, &job->y1)) {
+        return;
+    }
+
+    /* work tiles on the storage grid, sdfrender_rect clips
+     * them back to the bounds
+     */
+    if (dr->format == SDFBLEND_TILED) {
+        job->x0 -= job->x0 % SDFRENDER_TILE;
+        job->y0 -= job->y0 % SDFRENDER_TILE;
+    }
+
+    job->tiles_x = (job->x1 - job->x0 + SDFRENDER_TILE - 1) / SDFRENDER_TILE;
+    tiles_y = (job->y1 - job->y0 + SDFRENDER_TILE - 1) / SDFRENDER_TILE;
+    job->ntiles = job->tiles_x * tiles_y;
+}
+
+static void push(sdfrender_deque *dq, int job, int t0, int t1)
+{
+    sdfrender_range *rng;
+
+    pthread_mutex_lock(&dq->lock);
+    rng = &dq->range[(dq->head + dq->count) % (SDFRENDER_MAXJOBS + 1)];
+    rng->job = job;
+    rng->t0 = t0;
+    rng->t1 = t1;
+    dq->count++;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+static int pop(sdfrender_deque *dq, int *job, int *tile)
+{
+    sdfrender_range *rng;
+
+    pthread_mutex_lock(&dq->lock);
+
+    if (dq->count == 0) {
+        pthread_mutex_unlock(&dq->lock);
+        return 0;
+    }
+
+    rng = &dq->range[dq->head];
+    *job = rng->job;
+    *tile = rng->t0++;
+
+    if (rng->t0 >= rng->t1) {
+        dq->head = (dq->head + 1) % (SDFRENDER_MAXJOBS + 1);
+        dq->count--;
+    }
+
+    pthread_mutex_unlock(&dq->lock);
+    return 1;
+}
+
+/* take the back half of the victim's largest range */
+static int steal(sdfrender_deque *dq, sdfrender_range *out)
+{
+    int i;
+    int best, most;
+    sdfrender_range *rng;
+
+    pthread_mutex_lock(&dq->lock);
+
+    best = -1;
+    most = 0;
+    for (i = 0; i < dq->count; i++) {
+        int pos, left;
+        pos = (dq->head + i) % (SDFRENDER_MAXJOBS + 1);
+        left = dq->range[pos].t1 - dq->range[pos].t0;
+        if (left > most) {
+            most = left;
+            best = pos;
+        }
+    }
+
+    if (best < 0) {
+        pthread_mutex_unlock(&dq->lock);
+        return 0;
+    }
+
+    rng = &dq->range[best];
+    out->job = rng->job;
+    out->t1 = rng->t1;
+    out->t0 = rng->t1 - (most + 1) / 2;
+    rng->t1 = out->t0;
+
+    /* emptied: close the gap, keeping the ring in order */
+    if (rng->t0 >= rng->t1) {
+        int pos, nxt;
+        pos = best;
+        while (pos != (dq->head + dq->count - 1) % (SDFRENDER_MAXJOBS + 1)) {
+            nxt = (pos + 1) % (SDFRENDER_MAXJOBS + 1);
+            dq->range[pos] = dq->range[nxt];
+            pos = nxt;
+        }
+        dq->count--;
+    }
+
+    pthread_mutex_unlock(&dq->lock);
+    return 1;
+}
+
+static int next_tile(sdfrender_worker *w, int *job, int *tile)
+{
+    sdfrender *r;
+    int i;
+
+    if (pop(&w->dq, job, tile)) return 1;
+
+    r = w->r;
+
+    for (i = 1; i < r->nworkers; i++) {
+        sdfrender_range rng;
+        sdfrender_worker *victim;
+
+        victim = r->workers[(w->id + i) % r->nworkers];
+
+        /* still starting up */
+        if (victim == NULL) continue;
+
+        if (!steal(&victim->dq, &rng)) continue;
+
+        w->stats.steals++;
+        *job = rng.job;
+        *tile = rng.t0;
+
+        if (rng.t1 - rng.t0 > 1) {
+            push(&w->dq, rng.job, rng.t0 + 1, rng.t1);
+
+            /* others may be asleep, and there is more to share */
+            pthread_mutex_lock(&r->lock);
+            r->gen++;
+            pthread_cond_broadcast(&r->work);
+            pthread_mutex_unlock(&r->lock);
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static void finish(sdfrender *r, sdfrender_job *job)
+{
+    pthread_mutex_lock(&r->lock);
+
+    job->done++;
+
+    if (job->done >= job->ntiles) {
+        /* jobs can finish out of order, free from the oldest */
+        while (r->njobs > 0) {
+            sdfrender_job *head;
+            head = &r->jobs[r->head];
+            if (head->done < head->ntiles) break;
+            r->head = (r->head + 1) % SDFRENDER_MAXJOBS;
+            r->njobs--;
+            r->retired++;
+        }
+
+        pthread_cond_broadcast(&r->done);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+}
+
+static int run_one(sdfrender_worker *w)
+{
+    int job, tile;
+    sdfrender_job *j;
+
+    if (!next_tile(w, &job, &tile)) return 0;
+
+    j = &w->r->jobs[job];
+    run_item(w, j, tile);
+    finish(w->r, j);
+
+    return 1;
+}
+
+static void *worker_loop(void *arg)
+{
+    sdfrender_worker *w;
+    sdfrender *r;
+
+    w = arg;
+    r = w->r;
+
+    while (1) {
+        unsigned long gen;
+
+        pthread_mutex_lock(&r->lock);
+        if (r->quit) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        gen = r->gen;
+        pthread_mutex_unlock(&r->lock);
+
+        while (run_one(w));
+
+        pthread_mutex_lock(&r->lock);
+        if (!r->quit && r->gen == gen) {
+            pthread_cond_wait(&r->work, &r->lock);
+        }
+        pthread_mutex_unlock(&r->lock);
+    }
+
+    return NULL;
+}
+
+/* CPUs allowed by a v2 cpu.max, 0 if unlimited, -1 if unreadable */
+static int cpu_max(const char *file)
+{
+    FILE *fp;
+    char quota[32];
+    long q, period;
+    int n;
+
+    fp = fopen(file, "r");
+    if (fp == NULL) return -1;
+
+    /* "max 100000" or "200000 100000" */
+    n = 0;
+    if (fscanf(fp, "%31s %ld", quota, &period) == 2 &&
+        strcmp(quota, "max") && period > 0) {
+        q = atol(quota);
+        if (q > 0) n = (q + period - 1) / period;
+    }
+    fclose(fp);
+
+    return n;
+}
+
+/* The tightest cpu.max from the process's v2 cgroup up to the
+ * root of the mount, 0 if unlimited, -1 if there is none. On a
+ * host the process usually sits in a nested cgroup whose quota
+ * the root does not show.
+ */
+static int cgroup2_cpus(void)
+{
+    FILE *fp;
+    char line[512];
+    char file[600];
+    char *path, *end;
+    int n, best, found;
+
+    path = NULL;
+    fp = fopen("/proc/self/cgroup", "r");
+    if (fp != NULL) {
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (!strncmp(line, "0::", 3)) {
+                path = line + 3;
+                path[strcspn(path, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    if (path == NULL || path[0] != '/') path = "/";
+
+    best = 0;
+    found = 0;
+    while (1) {
+        sprintf(file, "/sys/fs/cgroup%s/cpu.max",
+                strcmp(path, "/") ? path : "");
+        n = cpu_max(file);
+        if (n >= 0) found = 1;
+        if (n > 0 && (best == 0 || n < best)) best = n;
+
+        /* on to the parent */
+        end = strrchr(path, '/');
+        if (end == NULL || end == path) {
+            if (!strcmp(path, "/")) break;
+            path = "/";
+        } else {
+            *end = '\0';
+        }
+    }
+
+    return found ? best : -1;
+}
+
+/* CPUs allowed by the cgroup quota, 0 if unlimited */
+static int cgroup_cpus(void)
+{
+    FILE *fp;
+    long q, period;
+    int n;
+
+    n = cgroup2_cpus();
+    if (n >= 0) return n;
+
+    /* v1 */
+    q = -1;
+    period = 0;
+    fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%ld", &q) != 1) q = -1;
+        fclose(fp);
+    }
+    fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%ld", &period) != 1) period = 0;
+        fclose(fp);
+    }
+
+    if (q <= 0 || period <= 0) return 0;
+    return (q + period - 1) / period;
+}
+
+int sdfrender_ncpus(void)
+{
+    int n;
+    int quota;
+
+    n = 0;
+
+#ifdef __linux__
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            n = CPU_COUNT(&set);
+        }
+    }
+#endif
+
+    if (n <= 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    quota = cgroup_cpus();
+    if (quota > 0 && quota < n) n = quota;
+    if (n < 1) n = 1;
+
+    return n;
+}
+
+/* pin the calling thread to the nth CPU it is allowed on */
+static int pin(int nth)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int cpu, n;
+
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set)) return -1;
+
+    n = CPU_COUNT(&set);
+    if (n <= 0) return -1;
+    nth %= n;
+
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        if (nth-- == 0) break;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) return -1;
+
+    return cpu;
+#else
+    return -1;
+#endif
+}
+
+static sdfrender_worker *worker_new(sdfrender *r, int id)
+{
+    void *mem;
+    sdfrender_worker *w;
+
+    if (posix_memalign(&mem, 64, sizeof(sdfrender_worker))) return NULL;
+
+    /* first touch happens here, on the worker's own core */
+    memset(mem, 0, sizeof(sdfrender_worker));
+    w = mem;
+    w->r = r;
+    w->id = id;
+    w->cpu = -1;
+    w->dq.head = 0;
+    w->dq.count = 0;
+    w->vm = NULL;
+    w->scratch = NULL;
+    w->scratchsz = 0;
+    pthread_mutex_init(&w->dq.lock, NULL);
+
+    return w;
+}
+
+static void worker_del(sdfrender_worker *w)
+{
+    pthread_mutex_destroy(&w->dq.lock);
+    free(w->vm);
+    free(w->scratch);
+    free(w);
+}
+
+struct start {
+    sdfrender *r;
+    int id;
+};
+
+static void *thread_main(void *arg)
+{
+    struct start *st;
+    sdfrender *r;
+    sdfrender_worker *w;
+    int id;
+    int cpu;
+
+    st = arg;
+    r = st->r;
+    id = st->id;
+    free(st);
+
+    cpu = -1;
+    if (r->flags & SDFRENDER_PIN) cpu = pin(id);
+
+    w = worker_new(r, id);
+
+    pthread_mutex_lock(&r->lock);
+    if (w != NULL) {
+        w->cpu = cpu;
+        r->workers[id] = w;
+    } else {
+        r->failed = 1;
+    }
+    r->ready++;
+    pthread_cond_broadcast(&r->done);
+    pthread_mutex_unlock(&r->lock);
+
+    if (w == NULL) return NULL;
+
+    return worker_loop(w);
+}
+
+int sdfrender_init(sdfrender *r, int nworkers, int flags)
+{
+    int i;
+
+    if (nworkers <= SDFRENDER_AUTO) {
+        const char *env;
+        env = getenv("SDF2D_THREADS");
+        nworkers = 0;
+        if (env != NULL) nworkers = atoi(env);
+        if (nworkers <= 0) nworkers = sdfrender_ncpus();
+    }
+
+    r->nworkers = nworkers;
+    r->nthreads = 0;
+    r->inline_px = SDFRENDER_INLINE;
+    r->flags = flags;
+    r->ready = 0;
+    r->failed = 0;
+    r->head = 0;
+    r->njobs = 0;
+    r->gen = 0;
+    r->quit = 0;
+    r->submitted = 0;
+    r->retired = 0;
+
+    r->workers = calloc(r->nworkers, sizeof(sdfrender_worker *));
+    r->threads = calloc(r->nworkers, sizeof(pthread_t));
+
+    if (r->workers == NULL || r->threads == NULL) {
+        free(r->workers);
+        free(r->threads);
+        r->workers = NULL;
+        return SDFRENDER_NOT_OK;
+    }
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->work, NULL);
+    pthread_cond_init(&r->done, NULL);
+
+    /* the caller stays where it is */
+    r->workers[0] = worker_new(r, 0);
+    if (r->workers[0] == NULL) {
+        sdfrender_clean(r);
+        return SDFRENDER_NOT_OK;
+    }
+
+    for (i = 1; i < r->nworkers; i++) {
+        struct start *st;
+
+        st = malloc(sizeof(struct start));
+        if (st == NULL) break;
+        st->r = r;
+        st->id = i;
+
+        if (pthread_create(&r->threads[i], NULL, thread_main, st)) {
+            free(st);
+            break;
+        }
+        r->nthreads++;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    while (r->ready < r->nthreads) {
+        pthread_cond_wait(&r->done, &r->lock);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if (r->nthreads < r->nworkers - 1 || r->failed) {
+        sdfrender_clean(r);
+        return SDFRENDER_NO_THREADS;
+    }
+
+    return SDFRENDER_OK;
+}
+
+void sdfrender_clean(sdfrender *r)
+{
+    int i;
+
+    if (r->workers == NULL) return;
+
+    pthread_mutex_lock(&r->lock);
+    r->quit = 1;
+    pthread_cond_broadcast(&r->work);
+    pthread_mutex_unlock(&r->lock);
+
+    for (i = 1; i <= r->nthreads; i++) {
+        pthread_join(r->threads[i], NULL);
+    }
+
+    for (i = 0; i < r->nworkers; i++) {
+        if (r->workers[i] != NULL) worker_del(r->workers[i]);
+    }
+
+    pthread_cond_destroy(&r->work);
+    pthread_cond_destroy(&r->done);
+    pthread_mutex_destroy(&r->lock);
+
+    free(r->workers);
+    free(r->threads);
+    r->workers = NULL;
+    r->threads = NULL;
+    r->nworkers = 0;
+    r->nthreads = 0;
+}
+
+void sdfrender_inline(sdfrender *r, int npixels)
+{
+    r->inline_px = npixels;
+}
+
+int sdfrender_nworkers(sdfrender *r)
+{
+    return r->nworkers;
+}
+
+int sdfrender_worker_id(sdfrender_worker *w)
+{
+    return w->id;
+}
+
+sdfvm *sdfrender_worker_vm(sdfrender_worker *w)
+{
+    if (w->vm == NULL) {
+        w->vm = malloc(sdfvm_sizeof());
+        if (w->vm != NULL) sdfvm_init(w->vm);
+    }
+
+    return w->vm;
+}
+
+void *sdfrender_worker_scratch(sdfrender_worker *w, size_t size)
+{
+    /* contents are not kept when it grows */
+    if (size > w->scratchsz) {
+        free(w->scratch);
+        w->scratch = malloc(size);
+        w->scratchsz = w->scratch != NULL ? size : 0;
+    }
+
+    return w->scratch;
+}
+
+/* wait for a free job slot, helping out in the meantime */
+static sdfrender_job *reserve(sdfrender *r, int *pos)
+{
+    pthread_mutex_lock(&r->lock);
+    while (r->njobs >= SDFRENDER_MAXJOBS) {
+        pthread_mutex_unlock(&r->lock);
+        if (run_one(r->workers[0])) {
+            pthread_mutex_lock(&r->lock);
+            continue;
+        }
+        pthread_mutex_lock(&r->lock);
+        if (r->njobs >= SDFRENDER_MAXJOBS) {
+            pthread_cond_wait(&r->done, &r->lock);
+        }
+    }
+    *pos = (r->head + r->njobs) % SDFRENDER_MAXJOBS;
+    pthread_mutex_unlock(&r->lock);
+
+    return &r->jobs[*pos];
+}
+
+/* queue a job set up in a reserved slot */
+static void enqueue(sdfrender *r, sdfrender_job *job, int pos)
+{
+    int i;
+    int per, t0;
+
+    if (job->ntiles <= 0) return;
+
+    pthread_mutex_lock(&r->lock);
+    r->njobs++;
+    r->submitted++;
+    pthread_mutex_unlock(&r->lock);
+
+    /* contiguous runs of tiles per worker keep neighbours together */
+    per = (job->ntiles + r->nworkers - 1) / r->nworkers;
+    t0 = 0;
+    for (i = 0; i < r->nworkers && t0 < job->ntiles; i++) {
+        int t1;
+        t1 = t0 + per;
+        if (t1 > job->ntiles) t1 = job->ntiles;
+        push(&r->workers[i]->dq, pos, t0, t1);
+        t0 = t1;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->gen++;
+    pthread_cond_broadcast(&r->work);
+    pthread_mutex_unlock(&r->lock);
+}
+
+int sdfrender_submit(sdfrender *r, const sdfrender_draw *dr)
+{
+    sdfrender_job *job;
+    int pos;
+    int x0, y0, x1, y1;
+
+    if (dr->dist == NULL || dr->buf == NULL) return SDFRENDER_NOT_OK;
+
+    if (!sdfrender_draw_bounds(dr, &x0, &y0, &x1, &y1)) return SDFRENDER_OK;
+
+    /* not worth waking anyone up for */
+    if (r->nthreads == 0 || (x1 - x0) * (y1 - y0) < r->inline_px) {
+        sdfrender_job tmp;
+        int i;
+        job_setup(&tmp, dr);
+        for (i = 0; i < tmp.ntiles; i++) {
+            run_item(r->workers[0], &tmp, i);
+        }
+        return SDFRENDER_OK;
+    }
+
+    job = reserve(r, &pos);
+    job_setup(job, dr);
+    enqueue(r, job, pos);
+
+    return SDFRENDER_OK;
+}
+
+int sdfrender_submit_task(sdfrender *r,
+                          sdfrender_task task,
+                          void *ud,
+                          int nitems)
+{
+    sdfrender_job *job;
+    int pos;
+
+    if (task == NULL) return SDFRENDER_NOT_OK;
+    if (nitems <= 0) return SDFRENDER_OK;
+
+    if (r->nthreads == 0) {
+        int i;
+        for (i = 0; i < nitems; i++) {
+            double t;
+            t = now();
+            task(r->workers[0], ud, i);
+            r->workers[0]->stats.tiles++;
+            r->workers[0]->stats.busy += now() - t;
+        }
+        return SDFRENDER_OK;
+    }
+
+    job = reserve(r, &pos);
+    sdfrender_draw_init(&job->dr);
+    job->task = task;
+    job->ud = ud;
+    job->x0 = job->y0 = job->x1 = job->y1 = 0;
+    job->tiles_x = 0;
+    job->ntiles = nitems;
+    job->done = 0;
+    enqueue(r, job, pos);
+
+    return SDFRENDER_OK;
+}
+
+void sdfrender_barrier(sdfrender *r)
+{
+    while (1) {
+        while (run_one(r->workers[0]));
+
+        pthread_mutex_lock(&r->lock);
+        if (r->njobs == 0) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        pthread_cond_wait(&r->done, &r->lock);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+unsigned long sdfrender_fence(sdfrender *r)
+{
+    unsigned long fence;
+
+    pthread_mutex_lock(&r->lock);
+    fence = r->submitted;
+    pthread_mutex_unlock(&r->lock);
+
+    return fence;
+}
+
+int sdfrender_poll(sdfrender *r, unsigned long fence)
+{
+    int done;
+
+    pthread_mutex_lock(&r->lock);
+    done = r->retired >= fence;
+    pthread_mutex_unlock(&r->lock);
+
+    return done;
+}
+
+void sdfrender_wait(sdfrender *r, unsigned long fence)
+{
+    while (1) {
+        /* help until our own deque runs dry */
+        while (!sdfrender_poll(r, fence) && run_one(r->workers[0]));
+
+        pthread_mutex_lock(&r->lock);
+        if (r->retired >= fence) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        pthread_cond_wait(&r->done, &r->lock);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+int sdfrender_run(sdfrender *r, const sdfrender_draw *dr)
+{
+    int rc;
+
+    rc = sdfrender_submit(r, dr);
+    if (rc) return rc;
+    sdfrender_barrier(r);
+
+    return SDFRENDER_OK;
+}
+
+void sdfrender_stats_get(sdfrender *r, int worker, sdfrender_stats *st)
+{
+    int i;
+
+    if (worker != SDFRENDER_ALL) {
+        if (worker < 0 || worker >= r->nworkers) {
+            memset(st, 0, sizeof(sdfrender_stats));
+            return;
+        }
+
+        *st = r->workers[worker]->stats;
+        return;
+    }
+
+    memset(st, 0, sizeof(sdfrender_stats));
+
+    for (i = 0; i < r->nworkers; i++) {
+        sdfrender_stats *ws;
+        ws = &r->workers[i]->stats;
+        st->tiles += ws->tiles;
+        st->pixels += ws->pixels;
+        st->samples += ws->samples;
+        st->culled += ws->culled;
+        st->supersampled += ws->supersampled;
+        st->steals += ws->steals;
+        st->busy += ws->busy;
+    }
+}
+
+void sdfrender_stats_reset(sdfrender *r)
+{
+    int i;
+
+    for (i = 0; i < r->nworkers; i++) {
+        memset(&r->workers[i]->stats, 0, sizeof(sdfrender_stats));
+    }
+}
+
+void sdfrender_stats_print(sdfrender *r, FILE *fp)
+{
+    int i;
+    double total, most;
+    sdfrender_stats all;
+
+    total = 0;
+    most = 0;
+
+    for (i = 0; i < r->nworkers; i++) {
+        sdfrender_stats *st;
+        st = &r->workers[i]->stats;
+        fprintf(fp, "worker %d (cpu %d): "
+                "%lu tiles, %lu pixels, %lu samples, %lu culled, "
+                "%lu supersampled, %lu steals, %.3fms\n",
+                i, r->workers[i]->cpu,
+                st->tiles, st->pixels, st->samples, st->culled,
+                st->supersampled, st->steals, st->busy * 1000);
+        total += st->busy;
+        if (st->busy > most) most = st->busy;
+    }
+
+    /* 1.0 is perfectly even */
+    if (total > 0) {
+        fprintf(fp, "imbalance: %.2f\n", most / (total / r->nworkers));
+    }
+
+    sdfrender_stats_get(r, SDFRENDER_ALL, &all);
+    if (all.supersampled > 0) {
+        fprintf(fp, "supersampled: %.2f%% of pixels\n",
+                100.0 * all.supersampled / all.pixels);
+    }
+}
@@ -0,0 +1,253 @@
+#ifndef SDF2D_SDFRENDER_H
+#define SDF2D_SDFRENDER_H
+
+typedef struct sdfrender sdfrender;
+typedef struct sdfrender_worker sdfrender_worker;
+typedef struct sdfrender_draw sdfrender_draw;
+
+/* edge of a square work tile, in pixels */
+#define SDFRENDER_TILE 32
+
+/* draws covering fewer pixels than this run on the caller */
+#define SDFRENDER_INLINE 4096
+
+/* culling stops splitting at blocks this small */
+#define SDFRENDER_CULL_LEAF 8
+
+/* pick the worker count from the CPUs this process may use */
+#define SDFRENDER_AUTO 0
+
+/* most subsamples per pixel side */
+#define SDFRENDER_MAXSAMPLES 8
+
+/* sdfrender_stats_get: all workers summed */
+#define SDFRENDER_ALL -1
+
+/* init flags */
+#define SDFRENDER_PIN 1
+
+enum {
+    SDFRENDER_OK,
+    SDFRENDER_NOT_OK,
+    SDFRENDER_NO_THREADS
+};
+
+/* distance at st, a pixel offset inside the draw region.
+ * negative inside, like the sdf_* functions.
+ */
+typedef float (*sdfrender_dist)(struct vec2 st,
+                                const sdfrender_draw *dr,
+                                sdfrender_worker *w);
+
+/* one item of a generic parallel job */
+typedef void (*sdfrender_task)(sdfrender_worker *w, void *ud, int item);
+
+struct sdfrender_draw {
+    /* target canvas, stride in pixels. A SDFBLEND_PLANAR
+     * buf is a sdfblend_planes, with its stride. A
+     * SDFBLEND_TILED buf is a sdfblend_tiles, stride its width.
+     */
+    void *buf;
+    int format;
+    int width;
+    int height;
+    int stride;
+
+    /* x, y, w, h in pixels */
+    struct vec4 region;
+
+    /* Optional tighter bounds, x, y, w, h in canvas pixels.
+     * Pixels outside are left alone. Zero size for none.
+     */
+    struct vec4 clip;
+
+    sdfrender_dist dist;
+    void *ud;
+
+    struct vec3 clr;
+    int blend;
+    float feather;
+
+    /* Distance units per pixel, and a bound on how fast the
+     * distance can change per distance unit. With both set,
+     * blocks of pixels far from the edge are culled or filled
+     * without evaluating every pixel. Zero turns this off.
+     */
+    float scale;
+    float lipschitz;
+
+    /* Pixels within about a pixel of the edge take samples x
+     * samples subsamples and average their coverage, the rest
+     * take one. Needs scale. 1 turns it off.
+     */
+    int samples;
+
+    /* Optional coverage to blend instead of evaluating dist:
+     * mask_w x mask_h values, row by row, for the pixels from
+     * the one holding the region's corner. See sdfsprite.h.
+     */
+    const float *mask;
+    int mask_w;
+    int mask_h;
+};
+
+/* per-worker load, accumulated until reset */
+typedef struct {
+    unsigned long tiles;
+    unsigned long pixels;
+    /* distance evaluations, and pixels decided without one */
+    unsigned long samples;
+    unsigned long culled;
+    /* pixels that took extra samples */
+    unsigned long supersampled;
+    unsigned long steals;
+    double busy;
+} sdfrender_stats;
+
+#ifdef SDF2D_SDFRENDER_PRIV
+#define SDFRENDER_MAXJOBS 64
+
+typedef struct {
+    sdfrender_draw dr;
+
+    /* set for generic jobs, whose items are passed to task */
+    sdfrender_task task;
+    void *ud;
+
+    /* pixel bounds and tile grid */
+    int x0, y0, x1, y1;
+    int tiles_x;
+    int ntiles;
+
+    int done;
+} sdfrender_job;
+
+/* a run of tiles [t0, t1) of a job */
+typedef struct {
+    int job;
+    int t0, t1;
+} sdfrender_range;
+
+/* The owner takes tiles off the front of its oldest range.
+ * Thieves split the largest range and take the back half.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    sdfrender_range range[SDFRENDER_MAXJOBS + 1];
+    int head;
+    int count;
+} sdfrender_deque;
+
+/* Allocated by the thread that runs it, after pinning, so
+ * the memory is local to its core. Cache line aligned.
+ */
+struct sdfrender_worker {
+    sdfrender *r;
+    int id;
+    int cpu;
+    sdfrender_deque dq;
+    sdfrender_stats stats;
+    float d[SDFBLEND_CHUNK];
+    float a[SDFBLEND_CHUNK];
+    sdfvm *vm;
+    void *scratch;
+    size_t scratchsz;
+};
+
+struct sdfrender {
+    /* worker 0 is the calling thread */
+    sdfrender_worker **workers;
+    pthread_t *threads;
+    int nworkers;
+    int nthreads;
+    int inline_px;
+    int flags;
+
+    /* startup handshake */
+    int ready;
+    int failed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+
+    /* ring of jobs, head is the oldest unfinished one */
+    sdfrender_job jobs[SDFRENDER_MAXJOBS];
+    int head;
+    int njobs;
+
+    /* bumped whenever new tiles become available */
+    unsigned long gen;
+
+    /* jobs queued, and jobs finished and freed, in order */
+    unsigned long submitted;
+    unsigned long retired;
+    int quit;
+};
+#endif
+
+size_t sdfrender_sizeof(void);
+
+/* nworkers counts the calling thread. With SDFRENDER_AUTO,
+ * the SDF2D_THREADS environment variable wins over detection.
+ */
+int sdfrender_init(sdfrender *r, int nworkers, int flags);
+void sdfrender_clean(sdfrender *r);
+int sdfrender_ncpus(void);
+
+void sdfrender_draw_init(sdfrender_draw *dr);
+void sdfrender_inline(sdfrender *r, int npixels);
+int sdfrender_nworkers(sdfrender *r);
+int sdfrender_worker_id(sdfrender_worker *w);
+
+/* per-worker state, created on first use by the worker itself */
+sdfvm *sdfrender_worker_vm(sdfrender_worker *w);
+void *sdfrender_worker_scratch(sdfrender_worker *w, size_t size);
+
+/* Draws submitted between two barriers may run in any order
+ * and at the same time, so they must not overlap. Only one
+ * thread may submit to a context.
+ */
+int sdfrender_submit(sdfrender *r, const sdfrender_draw *dr);
+void sdfrender_barrier(sdfrender *r);
+
+/* A fence covers everything submitted before it was taken.
+ * Poll is nonzero once all of that is done. Wait lends the
+ * calling thread to the workers until then. Work that ran
+ * inline at submit is always done.
+ */
+unsigned long sdfrender_fence(sdfrender *r);
+int sdfrender_poll(sdfrender *r, unsigned long fence);
+void sdfrender_wait(sdfrender *r, unsigned long fence);
+
+/* submit, then wait */
+int sdfrender_run(sdfrender *r, const sdfrender_draw *dr);
+
+/* run task over items 0 .. nitems-1, same rules as draws */
+int sdfrender_submit_task(sdfrender *r,
+                          sdfrender_task task,
+                          void *ud,
+                          int nitems);
+
+/* The pixels dr can touch: region, clip and canvas, intersected.
+ * Zero if there are none.
+ */
+int sdfrender_draw_bounds(const sdfrender_draw *dr,
+                          int *x0, int *y0,
+                          int *x1, int *y1);
+
+/* Clip dr to a box in the shape space of sdf_normalize over the
+ * region, such as sdfshape_aabb gives, grown by the falloff.
+ */
+void sdfrender_draw_aabb(sdfrender_draw *dr, struct vec2 lo, struct vec2 hi);
+
+/* render the part of dr inside [x0, x1) x [y0, y1) */
+void sdfrender_rect(sdfrender_worker *w,
+                    const sdfrender_draw *dr,
+                    int x0, int y0,
+                    int x1, int y1);
+
+void sdfrender_stats_get(sdfrender *r, int worker, sdfrender_stats *st);
+void sdfrender_stats_reset(sdfrender *r);
+void sdfrender_stats_print(sdfrender *r, FILE *fp);
+#endif
@@ -0,0 +1,601 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfshape.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* distance wrappers */
+
+static float dist_circle(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_circle *c = ud;
+    return sdf_circle(p, c->r);
+}
+
+static float dist_heart(struct vec2 p, const void *ud)
+{
+    return sdf_heart(p);
+}
+
+static float dist_rounded_box(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_rounded_box *rb = ud;
+    return sdf_rounded_box(p, rb->b, rb->r);
+}
+
+static float dist_box(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_box *b = ud;
+    return sdf_box(p, b->b);
+}
+
+static float dist_rhombus(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_rhombus *rh = ud;
+    return sdf_rhombus(p, rh->b);
+}
+
+static float dist_equilateral_triangle(struct vec2 p, const void *ud)
+{
+    return sdf_equilateral_triangle(p);
+}
+
+static float dist_pentagon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ngon *n = ud;
+    return sdf_pentagon(p, n->r);
+}
+
+static float dist_hexagon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ngon *n = ud;
+    return sdf_hexagon(p, n->r);
+}
+
+static float dist_octogon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ngon *n = ud;
+    return sdf_octogon(p, n->r);
+}
+
+static float dist_hexagram(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ngon *n = ud;
+    return sdf_hexagram(p, n->r);
+}
+
+static float dist_star5(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_star5 *s = ud;
+    return sdf_star5(p, s->r, s->rf);
+}
+
+static float dist_rounded_x(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_rounded_x *rx = ud;
+    return sdf_rounded_x(p, rx->w, rx->r);
+}
+
+static float dist_vesica(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_vesica *v = ud;
+    return sdf_vesica(p, v->r, v->d);
+}
+
+static float dist_egg(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_egg *e = ud;
+    return sdf_egg(p, e->ra, e->rb);
+}
+
+static float dist_ellipse(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ellipse *e = ud;
+    return sdf_ellipse(p, e->ab);
+}
+
+static float dist_moon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_moon *m = ud;
+    return sdf_moon(p, m->d, m->ra, m->rb);
+}
+
+static float dist_polygon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_polygon *poly = ud;
+    return sdf_polygon(poly->v, poly->n, p);
+}
+
+static float dist_path(struct vec2 p, const void *ud)
+{
+    const struct sdf_path *path = ud;
+    return sdf_path(path->segs, path->nsegs, p);
+}
+
+/* bound wrappers */
+
+static float bound_hexagram(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ngon *n = ud;
+    return sdf_hexagram_bound(p, n->r);
+}
+
+static float bound_star5(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_star5 *s = ud;
+    return sdf_star5_bound(p, s->r, s->rf);
+}
+
+static float bound_vesica(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_vesica *v = ud;
+    return sdf_vesica_bound(p, v->r, v->d);
+}
+
+static float bound_egg(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_egg *e = ud;
+    return sdf_egg_bound(p, e->ra, e->rb);
+}
+
+static float bound_ellipse(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_ellipse *e = ud;
+    return sdf_ellipse_bound(p, e->ab);
+}
+
+static float bound_moon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_moon *m = ud;
+    return sdf_moon_bound(p, m->d, m->ra, m->rb);
+}
+
+static float bound_polygon(struct vec2 p, const void *ud)
+{
+    const struct sdfshape_polygon *poly = ud;
+    return sdf_polygon_bound(poly->v, poly->n, p);
+}
+
+/* bounding boxes */
+
+static void box_set(struct vec2 *lo, struct vec2 *hi,
+                    float x0, float y0, float x1, float y1)
+{
+    *lo = svec2(x0, y0);
+    *hi = svec2(x1, y1);
+}
+
+static void box_grow(struct vec2 *lo, struct vec2 *hi, struct vec2 p)
+{
+    if (p.x < lo->x) lo->x = p.x;
+    if (p.y < lo->y) lo->y = p.y;
+    if (p.x > hi->x) hi->x = p.x;
+    if (p.y > hi->y) hi->y = p.y;
+}
+
+static void aabb_circle(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_circle *c = ud;
+    box_set(lo, hi, -c->r, -c->r, c->r, c->r);
+}
+
+static void aabb_heart(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    /* lobes are circles at (+-0.25, 0.75) with radius sqrt(2)/4 */
+    box_set(lo, hi, -0.6035534, 0.0, 0.6035534, 1.1035534);
+}
+
+static void aabb_rounded_box(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_rounded_box *rb = ud;
+    box_set(lo, hi, -rb->b.x, -rb->b.y, rb->b.x, rb->b.y);
+}
+
+static void aabb_box(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_box *b = ud;
+    box_set(lo, hi, -b->b.x, -b->b.y, b->b.x, b->b.y);
+}
+
+static void aabb_rhombus(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_rhombus *rh = ud;
+    box_set(lo, hi, -rh->b.x, -rh->b.y, rh->b.x, rh->b.y);
+}
+
+static void aabb_equilateral_triangle(const void *ud,
+                                      struct vec2 *lo,
+                                      struct vec2 *hi)
+{
+    /* side length 2, centered on the centroid */
+    box_set(lo, hi, -1.0, -0.5773503, 1.0, 1.1547005);
+}
+
+static void aabb_pentagon(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_ngon *n = ud;
+    float cr;
+    /* r is the apothem, flat edge on top */
+    cr = n->r * 1.2360680;
+    box_set(lo, hi, -cr*0.9510565, -cr, cr*0.9510565, n->r);
+}
+
+static void aabb_hexagon(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_ngon *n = ud;
+    float cr;
+    cr = n->r * 1.1547005;
+    box_set(lo, hi, -cr, -n->r, cr, n->r);
+}
+
+static void aabb_octogon(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_ngon *n = ud;
+    box_set(lo, hi, -n->r, -n->r, n->r, n->r);
+}
+
+static void aabb_hexagram(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_ngon *n = ud;
+    /* tips at radius 2r, two of them on the y axis */
+    box_set(lo, hi, -1.7320508*n->r, -2*n->r, 1.7320508*n->r, 2*n->r);
+}
+
+static void aabb_star5(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_star5 *s = ud;
+    float ro;
+    /* tips at radius r, one pointing up; inner vertices at r*rf,
+     * one pointing down, which stick out past the tips for fat stars
+     */
+    ro = sdf_max(s->r, s->r*s->rf);
+    box_set(lo, hi,
+            -0.9510565*ro, -sdf_max(0.8090170*s->r, s->r*s->rf),
+            0.9510565*ro, sdf_max(s->r, 0.8090170*s->r*s->rf));
+}
+
+static void aabb_rounded_x(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_rounded_x *rx = ud;
+    float e;
+    e = 0.5*rx->w + rx->r;
+    box_set(lo, hi, -e, -e, e, e);
+}
+
+static void aabb_vesica(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_vesica *v = ud;
+    float b;
+    b = sqrt(sdf_max(v->r*v->r - v->d*v->d, 0.0));
+    box_set(lo, hi, -(v->r - v->d), -b, v->r - v->d, b);
+}
+
+static void aabb_egg(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_egg *e = ud;
+    box_set(lo, hi,
+            -e->ra, -e->ra,
+            e->ra, 1.7320508*(e->ra - e->rb) + e->rb);
+}
+
+static void aabb_ellipse(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_ellipse *e = ud;
+    box_set(lo, hi, -e->ab.x, -e->ab.y, e->ab.x, e->ab.y);
+}
+
+static void aabb_moon(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_moon *m = ud;
+    float xmax;
+
+    /* never bigger than the outer disk */
+    xmax = m->ra;
+
+    /* if the bite takes out the rightmost point, the horns are
+     * the furthest right
+     */
+    if (m->d > 0 && fabs(m->ra - m->d) < m->rb) {
+        float a;
+        a = (m->ra*m->ra - m->rb*m->rb + m->d*m->d)/(2.0*m->d);
+        if (a < xmax) xmax = a;
+    }
+
+    box_set(lo, hi, -m->ra, -m->ra, xmax, m->ra);
+}
+
+static void aabb_polygon(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdfshape_polygon *poly = ud;
+    int i;
+
+    if (poly->n <= 0) {
+        box_set(lo, hi, 0, 0, 0, 0);
+        return;
+    }
+
+    *lo = *hi = poly->v[0];
+    for (i = 1; i < poly->n; i++) box_grow(lo, hi, poly->v[i]);
+}
+
+static void aabb_path(const void *ud, struct vec2 *lo, struct vec2 *hi)
+{
+    const struct sdf_path *path = ud;
+    int i;
+
+    if (path->nsegs <= 0) {
+        box_set(lo, hi, 0, 0, 0, 0);
+        return;
+    }
+
+    *lo = *hi = path->segs[0].p[0];
+
+    for (i = 0; i < path->nsegs; i++) {
+        const struct sdf_path_seg *s;
+        s = &path->segs[i];
+        box_grow(lo, hi, s->p[0]);
+        box_grow(lo, hi, s->p[2]);
+
+        if (s->type == SDF_PATH_QUAD) {
+            /* the control point hull contains the curve */
+            box_grow(lo, hi, s->p[1]);
+        } else if (s->type == SDF_PATH_ARC) {
+            float t0, t1, a;
+            t0 = s->a0 < s->a1 ? s->a0 : s->a1;
+            t1 = s->a0 < s->a1 ? s->a1 : s->a0;
+            /* add any axis extremes that fall inside the sweep */
+            a = ceil(t0 / (0.5*M_PI)) * 0.5*M_PI;
+            for (; a < t1; a += 0.5*M_PI) {
+                box_grow(lo, hi, svec2(s->p[1].x + s->r*cos(a),
+                                       s->p[1].y + s->r*sin(a)));
+            }
+        }
+    }
+}
+
+/* parameter layouts */
+
+static const sdfshape_param params_circle[] = {
+    {"r", SDFSHAPE_FLOAT, offsetof(struct sdfshape_circle, r)}
+};
+
+static const sdfshape_param params_rounded_box[] = {
+    {"b", SDFSHAPE_VEC2, offsetof(struct sdfshape_rounded_box, b)},
+    {"r", SDFSHAPE_VEC4, offsetof(struct sdfshape_rounded_box, r)}
+};
+
+static const sdfshape_param params_box[] = {
+    {"b", SDFSHAPE_VEC2, offsetof(struct sdfshape_box, b)}
+};
+
+static const sdfshape_param params_rhombus[] = {
+    {"b", SDFSHAPE_VEC2, offsetof(struct sdfshape_rhombus, b)}
+};
+
+static const sdfshape_param params_ngon[] = {
+    {"r", SDFSHAPE_FLOAT, offsetof(struct sdfshape_ngon, r)}
+};
+
+static const sdfshape_param params_star5[] = {
+    {"r", SDFSHAPE_FLOAT, offsetof(struct sdfshape_star5, r)},
+    {"rf", SDFSHAPE_FLOAT, offsetof(struct sdfshape_star5, rf)}
+};
+
+static const sdfshape_param params_rounded_x[] = {
+    {"w", SDFSHAPE_FLOAT, offsetof(struct sdfshape_rounded_x, w)},
+    {"r", SDFSHAPE_FLOAT, offsetof(struct sdfshape_rounded_x, r)}
+};
+
+static const sdfshape_param params_vesica[] = {
+    {"r", SDFSHAPE_FLOAT, offsetof(struct sdfshape_vesica, r)},
+    {"d", SDFSHAPE_FLOAT, offsetof(struct sdfshape_vesica, d)}
+};
+
+static const sdfshape_param params_egg[] = {
+    {"ra", SDFSHAPE_FLOAT, offsetof(struct sdfshape_egg, ra)},
+    {"rb", SDFSHAPE_FLOAT, offsetof(struct sdfshape_egg, rb)}
+};
+
+static const sdfshape_param params_ellipse[] = {
+    {"ab", SDFSHAPE_VEC2, offsetof(struct sdfshape_ellipse, ab)}
+};
+
+static const sdfshape_param params_moon[] = {
+    {"d", SDFSHAPE_FLOAT, offsetof(struct sdfshape_moon, d)},
+    {"ra", SDFSHAPE_FLOAT, offsetof(struct sdfshape_moon, ra)},
+    {"rb", SDFSHAPE_FLOAT, offsetof(struct sdfshape_moon, rb)}
+};
+
+static const sdfshape_param params_polygon[] = {
+    {"v", SDFSHAPE_PTR, offsetof(struct sdfshape_polygon, v)},
+    {"n", SDFSHAPE_INT, offsetof(struct sdfshape_polygon, n)}
+};
+
+static const sdfshape_param params_path[] = {
+    {"segs", SDFSHAPE_PTR, offsetof(struct sdf_path, segs)},
+    {"nsegs", SDFSHAPE_INT, offsetof(struct sdf_path, nsegs)}
+};
+
+#define NPARAMS(p) (sizeof(p) / sizeof(*p))
+
+/* every primitive in sdf.c is exact, so the Lipschitz
+ * constant is 1 across the board.
+ */
+static const sdfshape shapes[] = {
+    {
+        SDFSHAPE_CIRCLE, "circle",
+        sizeof(struct sdfshape_circle),
+        NPARAMS(params_circle), params_circle,
+        dist_circle, dist_circle, aabb_circle,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_HEART, "heart",
+        0, 0, NULL,
+        dist_heart, dist_heart, aabb_heart,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_ROUNDED_BOX, "rounded_box",
+        sizeof(struct sdfshape_rounded_box),
+        NPARAMS(params_rounded_box), params_rounded_box,
+        dist_rounded_box, dist_rounded_box, aabb_rounded_box,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_BOX, "box",
+        sizeof(struct sdfshape_box),
+        NPARAMS(params_box), params_box,
+        dist_box, dist_box, aabb_box,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_RHOMBUS, "rhombus",
+        sizeof(struct sdfshape_rhombus),
+        NPARAMS(params_rhombus), params_rhombus,
+        dist_rhombus, dist_rhombus, aabb_rhombus,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_EQUILATERAL_TRIANGLE, "equilateral_triangle",
+        0, 0, NULL,
+        dist_equilateral_triangle,
+        dist_equilateral_triangle,
+        aabb_equilateral_triangle,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_PENTAGON, "pentagon",
+        sizeof(struct sdfshape_ngon),
+        NPARAMS(params_ngon), params_ngon,
+        dist_pentagon, dist_pentagon, aabb_pentagon,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_HEXAGON, "hexagon",
+        sizeof(struct sdfshape_ngon),
+        NPARAMS(params_ngon), params_ngon,
+        dist_hexagon, dist_hexagon, aabb_hexagon,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_OCTOGON, "octogon",
+        sizeof(struct sdfshape_ngon),
+        NPARAMS(params_ngon), params_ngon,
+        dist_octogon, dist_octogon, aabb_octogon,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_HEXAGRAM, "hexagram",
+        sizeof(struct sdfshape_ngon),
+        NPARAMS(params_ngon), params_ngon,
+        dist_hexagram, bound_hexagram, aabb_hexagram,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_STAR5, "star5",
+        sizeof(struct sdfshape_star5),
+        NPARAMS(params_star5), params_star5,
+        dist_star5, bound_star5, aabb_star5,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_ROUNDED_X, "rounded_x",
+        sizeof(struct sdfshape_rounded_x),
+        NPARAMS(params_rounded_x), params_rounded_x,
+        dist_rounded_x, dist_rounded_x, aabb_rounded_x,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_VESICA, "vesica",
+        sizeof(struct sdfshape_vesica),
+        NPARAMS(params_vesica), params_vesica,
+        dist_vesica, bound_vesica, aabb_vesica,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_EGG, "egg",
+        sizeof(struct sdfshape_egg),
+        NPARAMS(params_egg), params_egg,
+        dist_egg, bound_egg, aabb_egg,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_ELLIPSE, "ellipse",
+        sizeof(struct sdfshape_ellipse),
+        NPARAMS(params_ellipse), params_ellipse,
+        dist_ellipse, bound_ellipse, aabb_ellipse,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_MOON, "moon",
+        sizeof(struct sdfshape_moon),
+        NPARAMS(params_moon), params_moon,
+        dist_moon, bound_moon, aabb_moon,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_POLYGON, "polygon",
+        sizeof(struct sdfshape_polygon),
+        NPARAMS(params_polygon), params_polygon,
+        dist_polygon, bound_polygon, aabb_polygon,
+        SDFSHAPE_EXACT, 1.0
+    },
+    {
+        SDFSHAPE_PATH, "path",
+        sizeof(struct sdf_path),
+        NPARAMS(params_path), params_path,
+        dist_path, dist_path, aabb_path,
+        SDFSHAPE_EXACT, 1.0
+    }
+};
+
+const sdfshape *sdfshape_get(int id)
+{
+    if (id < 0 || id >= SDFSHAPE_LAST) return NULL;
+    return &shapes[id];
+}
+
+const sdfshape *sdfshape_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < SDFSHAPE_LAST; i++) {
+        if (!strcmp(shapes[i].name, name)) return &shapes[i];
+    }
+
+    return NULL;
+}
+
+float sdfshape_dist(int id, struct vec2 p, const void *params)
+{
+    const sdfshape *s;
+    s = sdfshape_get(id);
+    if (s == NULL) return 0;
+    return s->dist(p, params);
+}
+
+float sdfshape_bound(int id, struct vec2 p, const void *params)
+{
+    const sdfshape *s;
+    s = sdfshape_get(id);
+    if (s == NULL) return 0;
+    return s->bound(p, params);
+}
+
+int sdfshape_aabb(int id,
+                  const void *params,
+                  struct vec2 *lo,
+                  struct vec2 *hi)
+{
+    const sdfshape *s;
+    s = sdfshape_get(id);
+    if (s == NULL) return 1;
+    s->aabb(params, lo, hi);
+    return 0;
+}
@@ -0,0 +1,148 @@
+#ifndef SDF2D_SDFSHAPE_H
+#define SDF2D_SDFSHAPE_H
+
+typedef struct sdfshape sdfshape;
+typedef struct sdfshape_param sdfshape_param;
+
+enum {
+    SDFSHAPE_CIRCLE,
+    SDFSHAPE_HEART,
+    SDFSHAPE_ROUNDED_BOX,
+    SDFSHAPE_BOX,
+    SDFSHAPE_RHOMBUS,
+    SDFSHAPE_EQUILATERAL_TRIANGLE,
+    SDFSHAPE_PENTAGON,
+    SDFSHAPE_HEXAGON,
+    SDFSHAPE_OCTOGON,
+    SDFSHAPE_HEXAGRAM,
+    SDFSHAPE_STAR5,
+    SDFSHAPE_ROUNDED_X,
+    SDFSHAPE_VESICA,
+    SDFSHAPE_EGG,
+    SDFSHAPE_ELLIPSE,
+    SDFSHAPE_MOON,
+    SDFSHAPE_POLYGON,
+    SDFSHAPE_PATH,
+    SDFSHAPE_LAST
+};
+
+/* parameter types */
+enum {
+    SDFSHAPE_FLOAT,
+    SDFSHAPE_VEC2,
+    SDFSHAPE_VEC4,
+    SDFSHAPE_INT,
+    SDFSHAPE_PTR
+};
+
+/* what the distance function returns */
+enum {
+    SDFSHAPE_EXACT,
+    SDFSHAPE_BOUND
+};
+
+/* parameter blocks, one per parameterised primitive.
+ * the heart and equilateral triangle take none.
+ */
+
+struct sdfshape_circle {
+    float r;
+};
+
+struct sdfshape_rounded_box {
+    struct vec2 b;
+    struct vec4 r;
+};
+
+struct sdfshape_box {
+    struct vec2 b;
+};
+
+struct sdfshape_rhombus {
+    struct vec2 b;
+};
+
+/* pentagon, hexagon, octogon, hexagram */
+struct sdfshape_ngon {
+    float r;
+};
+
+struct sdfshape_star5 {
+    float r;
+    float rf;
+};
+
+struct sdfshape_rounded_x {
+    float w;
+    float r;
+};
+
+struct sdfshape_vesica {
+    float r;
+    float d;
+};
+
+struct sdfshape_egg {
+    float ra;
+    float rb;
+};
+
+struct sdfshape_ellipse {
+    struct vec2 ab;
+};
+
+struct sdfshape_moon {
+    float d;
+    float ra;
+    float rb;
+};
+
+struct sdfshape_polygon {
+    struct vec2 *v;
+    int n;
+};
+
+/* paths use struct sdf_path from sdf.h */
+
+struct sdfshape_param {
+    const char *name;
+    int type;
+    size_t offset;
+};
+
+struct sdfshape {
+    int id;
+    const char *name;
+
+    /* parameter block size and layout */
+    size_t size;
+    int nparams;
+    const sdfshape_param *params;
+
+    /* distance in shape space, negative inside */
+    float (*dist)(struct vec2 p, const void *params);
+
+    /* cheaper conservative bound, |bound| <= |dist|.
+     * same as dist for shapes that don't have one.
+     */
+    float (*bound)(struct vec2 p, const void *params);
+
+    /* axis-aligned bounds of the interior in shape space */
+    void (*aabb)(const void *params, struct vec2 *lo, struct vec2 *hi);
+
+    /* SDFSHAPE_EXACT or SDFSHAPE_BOUND */
+    int kind;
+
+    /* |dist(a) - dist(b)| <= lipschitz * |a - b| */
+    float lipschitz;
+};
+
+const sdfshape *sdfshape_get(int id);
+const sdfshape *sdfshape_find(const char *name);
+float sdfshape_dist(int id, struct vec2 p, const void *params);
+float sdfshape_bound(int id, struct vec2 p, const void *params);
+int sdfshape_aabb(int id,
+                  const void *params,
+                  struct vec2 *lo,
+                  struct vec2 *hi);
+#endif
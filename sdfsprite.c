@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfvm.h"
+#include "sdfblend.h"
+#include "sdfrender.h"
+#define SDF2D_SDFSPRITE_PRIV
+#include "sdfsprite.h"
+
+size_t sdfsprite_sizeof(void)
+{
+    return sizeof(sdfsprite);
+}
+
+void sdfsprite_init(sdfsprite *s, size_t maxbytes)
+{
+    int i;
+
+    for (i = 0; i < SDFSPRITE_NBUCKETS; i++) s->bucket[i] = NULL;
+    s->newest = NULL;
+    s->oldest = NULL;
+    s->maxbytes = maxbytes;
+    s->subpixel = SDFSPRITE_SUBPIXEL;
+    s->sizesteps = SDFSPRITE_SIZESTEPS;
+    s->frame = 0;
+    memset(&s->stats, 0, sizeof(sdfsprite_stats));
+}
+
+void sdfsprite_clean(sdfsprite *s)
+{
+    sdfsprite_entry *e;
+    int subpixel, sizesteps;
+
+    e = s->newest;
+    while (e != NULL) {
+        sdfsprite_entry *older;
+        older = e->older;
+        free(e);
+        e = older;
+    }
+
+    subpixel = s->subpixel;
+    sizesteps = s->sizesteps;
+    sdfsprite_init(s, s->maxbytes);
+    sdfsprite_steps(s, subpixel, sizesteps);
+}
+
+void sdfsprite_steps(sdfsprite *s, int subpixel, int sizesteps)
+{
+    if (subpixel > 0) s->subpixel = subpixel;
+    if (sizesteps > 0) s->sizesteps = sizesteps;
+}
+
+/* FNV-1a */
+static unsigned long mix(unsigned long h, const void *p, size_t n)
+{
+    const unsigned char *c;
+    size_t i;
+
+    c = p;
+    for (i = 0; i < n; i++) {
+        h ^= c[i];
+        h *= 16777619UL;
+        h &= 0xffffffffUL;
+    }
+
+    return h;
+}
+
+static unsigned long hash(const sdfsprite_entry *k)
+{
+    unsigned long h;
+
+    h = 2166136261UL;
+    h = mix(h, &k->dist, sizeof(k->dist));
+    h = mix(h, k->param, k->nparams * sizeof(int));
+    h = mix(h, &k->nparams, sizeof(int));
+    h = mix(h, &k->w, sizeof(int));
+    h = mix(h, &k->h, sizeof(int));
+    h = mix(h, &k->fx, sizeof(int));
+    h = mix(h, &k->fy, sizeof(int));
+    h = mix(h, &k->feather, sizeof(float));
+    h = mix(h, &k->samples, sizeof(int));
+
+    return h;
+}
+
+static int same(const sdfsprite_entry *a, const sdfsprite_entry *b)
+{
+    int i;
+
+    if (a->hash != b->hash ||
+        a->dist != b->dist ||
+        a->nparams != b->nparams ||
+        a->w != b->w || a->h != b->h ||
+        a->fx != b->fx || a->fy != b->fy ||
+        a->feather != b->feather ||
+        a->samples != b->samples) {
+        return 0;
+    }
+
+    for (i = 0; i < a->nparams; i++) {
+        if (a->param[i] != b->param[i]) return 0;
+    }
+
+    return 1;
+}
+
+static void unlink_lru(sdfsprite *s, sdfsprite_entry *e)
+{
+    if (e->newer != NULL) e->newer->older = e->older;
+    else s->newest = e->older;
+    if (e->older != NULL) e->older->newer = e->newer;
+    else s->oldest = e->newer;
+}
+
+static void push_lru(sdfsprite *s, sdfsprite_entry *e)
+{
+    e->newer = NULL;
+    e->older = s->newest;
+    if (s->newest != NULL) s->newest->newer = e;
+    s->newest = e;
+    if (s->oldest == NULL) s->oldest = e;
+}
+
+/* drop the least recently used masks not in the current frame */
+static void evict(sdfsprite *s)
+{
+    while (s->stats.bytes > s->maxbytes &&
+           s->oldest != NULL &&
+           s->oldest->frame != s->frame) {
+        sdfsprite_entry *e, **pp;
+
+        e = s->oldest;
+        unlink_lru(s, e);
+
+        pp = &s->bucket[e->hash % SDFSPRITE_NBUCKETS];
+        while (*pp != e) pp = &(*pp)->next;
+        *pp = e->next;
+
+        s->stats.bytes -= e->bytes;
+        s->stats.entries--;
+        s->stats.evictions++;
+        free(e);
+    }
+}
+
+/* Draw the snapped sprite white on black, in a canvas just
+ * big enough, so red is the coverage. Nothing moves by whole
+ * pixels, so it is what the renderer would have drawn at the
+ * snapped position.
+ */
+static sdfsprite_entry *rasterise(sdfrender *r,
+                                  const sdfrender_draw *dr,
+                                  const sdfsprite_entry *key,
+                                  struct vec4 region)
+{
+    sdfsprite_entry *e;
+    sdfrender_draw m;
+    struct vec3 *canvas;
+    int mw, mh;
+    size_t npx;
+    float grow;
+    size_t i;
+
+    mw = region.x + region.z;
+    mh = region.y + region.w;
+    npx = (size_t)mw * mh;
+
+    e = malloc(sizeof(sdfsprite_entry) + npx * sizeof(float));
+    if (e == NULL) return NULL;
+
+    *e = *key;
+    e->mask = (float *)(e + 1);
+    e->mask_w = mw;
+    e->mask_h = mh;
+    e->bytes = sizeof(sdfsprite_entry) + npx * sizeof(float);
+
+    if (npx == 0) return e;
+
+    canvas = calloc(npx, sizeof(struct vec3));
+    if (canvas == NULL) {
+        free(e);
+        return NULL;
+    }
+
+    m = *dr;
+    m.buf = canvas;
+    m.format = SDFBLEND_RGBF;
+    m.width = mw;
+    m.height = mh;
+    m.stride = mw;
+    m.region = region;
+    m.clip = svec4_zero();
+    m.clr = svec3(1, 1, 1);
+    m.blend = SDFBLEND_MIX;
+    m.mask = NULL;
+
+    /* a smaller region may change faster per pixel */
+    grow = 1;
+    if (dr->region.z > region.z) grow = dr->region.z / region.z;
+    if (dr->region.w > region.w && dr->region.w / region.w > grow) {
+        grow = dr->region.w / region.w;
+    }
+    m.scale = dr->scale * grow;
+
+    if (sdfrender_run(r, &m)) {
+        free(canvas);
+        free(e);
+        return NULL;
+    }
+
+    for (i = 0; i < npx; i++) e->mask[i] = canvas[i].x;
+
+    free(canvas);
+
+    return e;
+}
+
+int sdfsprite_draw(sdfsprite *s,
+                   sdfrender *r,
+                   const sdfrender_draw *dr,
+                   const float *params,
+                   int nparams,
+                   sdfrender_draw *out)
+{
+    sdfsprite_entry key;
+    sdfsprite_entry *e, **slot;
+    struct vec4 snap;
+    int ix, iy;
+    int i;
+
+    *out = *dr;
+
+    if (nparams < 0 || nparams > SDFSPRITE_MAXPARAMS || dr->mask != NULL) {
+        return SDFSPRITE_NOT_OK;
+    }
+
+    memset(&key, 0, sizeof(sdfsprite_entry));
+
+    ix = floor(dr->region.x);
+    iy = floor(dr->region.y);
+    key.fx = floor((dr->region.x - ix) * s->subpixel + 0.5);
+    key.fy = floor((dr->region.y - iy) * s->subpixel + 0.5);
+    if (key.fx >= s->subpixel) {
+        key.fx = 0;
+        ix++;
+    }
+    if (key.fy >= s->subpixel) {
+        key.fy = 0;
+        iy++;
+    }
+
+    key.w = floor(dr->region.z * s->sizesteps + 0.5);
+    key.h = floor(dr->region.w * s->sizesteps + 0.5);
+    if (key.w < 1) key.w = 1;
+    if (key.h < 1) key.h = 1;
+
+    key.dist = dr->dist;
+    key.nparams = nparams;
+    for (i = 0; i < nparams; i++) {
+        key.param[i] = floor(params[i] * SDFSPRITE_PARAMSTEPS + 0.5);
+    }
+    key.feather = dr->feather;
+    key.samples = dr->samples;
+
+    /* the snapped region, in the mask */
+    snap = svec4((float)key.fx / s->subpixel,
+                 (float)key.fy / s->subpixel,
+                 (float)key.w / s->sizesteps,
+                 (float)key.h / s->sizesteps);
+
+    if ((long)(snap.x + snap.z) * (long)(snap.y + snap.w) >
+        SDFSPRITE_MAXPIXELS) {
+        return SDFSPRITE_NOT_OK;
+    }
+
+    key.hash = hash(&key);
+    slot = &s->bucket[key.hash % SDFSPRITE_NBUCKETS];
+
+    for (e = *slot; e != NULL; e = e->next) {
+        if (same(e, &key)) break;
+    }
+
+    if (e != NULL) {
+        s->stats.hits++;
+        unlink_lru(s, e);
+    } else {
+        e = rasterise(r, dr, &key, snap);
+        if (e == NULL) return SDFSPRITE_NOT_OK;
+
+        s->stats.misses++;
+        s->stats.entries++;
+        s->stats.bytes += e->bytes;
+        e->next = *slot;
+        *slot = e;
+    }
+
+    push_lru(s, e);
+    e->frame = s->frame;
+    evict(s);
+
+    out->region = svec4(ix + snap.x, iy + snap.y, snap.z, snap.w);
+    out->mask = e->mask;
+    out->mask_w = e->mask_w;
+    out->mask_h = e->mask_h;
+
+    return SDFSPRITE_OK;
+}
+
+void sdfsprite_frame(sdfsprite *s)
+{
+    s->frame++;
+    evict(s);
+}
+
+void sdfsprite_stats_get(sdfsprite *s, sdfsprite_stats *st)
+{
+    *st = s->stats;
+}
@@ -0,0 +1,112 @@
+#ifndef SDF2D_SDFSPRITE_H
+#define SDF2D_SDFSPRITE_H
+
+typedef struct sdfsprite sdfsprite;
+typedef struct sdfsprite_entry sdfsprite_entry;
+
+/* defaults: offset buckets per pixel on each axis, and steps
+ * per pixel the region size is rounded to
+ */
+#define SDFSPRITE_SUBPIXEL 4
+#define SDFSPRITE_SIZESTEPS 2
+
+/* steps per unit the parameters are rounded to */
+#define SDFSPRITE_PARAMSTEPS 256
+
+#define SDFSPRITE_MAXPARAMS 8
+
+/* sprites with masks bigger than this are drawn as they are */
+#define SDFSPRITE_MAXPIXELS 16384
+
+#define SDFSPRITE_NBUCKETS 1024
+
+enum {
+    SDFSPRITE_OK,
+    SDFSPRITE_NOT_OK
+};
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long entries;
+    size_t bytes;
+} sdfsprite_stats;
+
+#ifdef SDF2D_SDFSPRITE_PRIV
+struct sdfsprite_entry {
+    /* key */
+    sdfrender_dist dist;
+    int param[SDFSPRITE_MAXPARAMS];
+    int nparams;
+    int w, h;
+    int fx, fy;
+    float feather;
+    int samples;
+    unsigned long hash;
+
+    float *mask;
+    int mask_w;
+    int mask_h;
+    size_t bytes;
+
+    /* the frame it was last handed out in */
+    unsigned long frame;
+
+    sdfsprite_entry *next;
+    sdfsprite_entry *newer;
+    sdfsprite_entry *older;
+};
+
+struct sdfsprite {
+    sdfsprite_entry *bucket[SDFSPRITE_NBUCKETS];
+    sdfsprite_entry *newest;
+    sdfsprite_entry *oldest;
+    size_t maxbytes;
+    int subpixel;
+    int sizesteps;
+    unsigned long frame;
+    sdfsprite_stats stats;
+};
+#endif
+
+size_t sdfsprite_sizeof(void);
+
+/* maxbytes caps the masks kept, least recently used go first */
+void sdfsprite_init(sdfsprite *s, size_t maxbytes);
+void sdfsprite_clean(sdfsprite *s);
+
+/* Coarser steps share more masks and move sprites further.
+ * Set before the first draw.
+ */
+void sdfsprite_steps(sdfsprite *s, int subpixel, int sizesteps);
+
+/* Turn dr into a blit of a cached coverage mask, written to
+ * out. The key is dr's distance function, params rounded to
+ * SDFSPRITE_PARAMSTEPS, the region size rounded to the size
+ * steps and its offset in the pixel to one of the subpixel
+ * buckets a side; colour and blend mode are
+ * not part of it. params are whatever beyond the size tells
+ * the shapes of one distance function apart. A miss draws the
+ * snapped sprite into a new mask on r, waiting for it.
+ *
+ * out moves the region by under a bucket and a size step, and
+ * is the same target and colour. On SDFSPRITE_NOT_OK (a sprite
+ * too big, or out of memory) out is a plain copy of dr.
+ */
+int sdfsprite_draw(sdfsprite *s,
+                   sdfrender *r,
+                   const sdfrender_draw *dr,
+                   const float *params,
+                   int nparams,
+                   sdfrender_draw *out);
+
+/* Start a frame. Masks handed out before may be evicted from
+ * here on, so call it once the draws using them are rendered.
+ * Masks in use in the current frame are never evicted, the cap
+ * is met again at a later frame.
+ */
+void sdfsprite_frame(sdfsprite *s);
+
+void sdfsprite_stats_get(sdfsprite *s, sdfsprite_stats *st);
+#endif
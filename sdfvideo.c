@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mathc/mathc.h"
+#include "sdfblend.h"
+#define SDF2D_SDFVIDEO_PRIV
+#include "sdfvideo.h"
+
+size_t sdfvideo_sizeof(void)
+{
+    return sizeof(sdfvideo);
+}
+
+static int write_all(int fd, const void *p, size_t n)
+{
+    const unsigned char *c;
+
+    c = p;
+    while (n > 0) {
+        ssize_t k;
+        k = write(fd, c, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return SDFVIDEO_IO;
+        c += k;
+        n -= k;
+    }
+
+    return SDFVIDEO_OK;
+}
+
+/* BT.601, limited range, in 8.8 fixed point */
+
+static int luma(const unsigned char *p)
+{
+    return ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+}
+
+/* row y of the canvas to rgb */
+static void rgb_row(sdfvideo *v, unsigned char *out, const void *canvas, int y)
+{
+    const unsigned char *row;
+
+    row = (const unsigned char *)canvas +
+          (size_t)y * v->width * sdfblend_pixsize(v->format);
+
+    if (v->quant != NULL) {
+        sdfblend_rgb8_quant(out, row, v->format, v->width, v->quant, 0, y);
+    } else {
+        sdfblend_rgb8(out, row, v->format, v->width);
+    }
+}
+
+/* a frame of the canvas into v->frame */
+static void encode(sdfvideo *v, const void *canvas)
+{
+    int w, h;
+    int cw;
+    int x, y;
+    unsigned char *yp, *up, *vp;
+
+    w = v->width;
+    h = v->height;
+
+    if (v->type == SDFVIDEO_RGB) {
+        for (y = 0; y < h; y++) {
+            rgb_row(v, v->frame + (size_t)y * w * 3, canvas, y);
+        }
+        return;
+    }
+
+    /* "FRAME\n", then the planes */
+    cw = (w + 1) / 2;
+    memcpy(v->frame, "FRAME\n", 6);
+    yp = v->frame + 6;
+    up = yp + (size_t)w * h;
+    vp = up + (size_t)cw * ((h + 1) / 2);
+
+    for (y = 0; y < h; y += 2) {
+        unsigned char *r0, *r1;
+
+        /* a lone last row pairs with itself */
+        r0 = v->rgb;
+        r1 = y + 1 < h ? v->rgb + (size_t)w * 3 : r0;
+        rgb_row(v, r0, canvas, y);
+        if (r1 != r0) rgb_row(v, r1, canvas, y + 1);
+
+        for (x = 0; x < w; x++) {
+            yp[(size_t)y * w + x] = luma(r0 + 3*x);
+            if (r1 != r0) yp[(size_t)(y + 1) * w + x] = luma(r1 + 3*x);
+        }
+
+        for (x = 0; x < cw; x++) {
+            int x1;
+            int c[3];
+            int k;
+
+            x1 = 2*x + 1 < w ? 2*x + 1 : 2*x;
+            for (k = 0; k < 3; k++) {
+                c[k] = (r0[6*x + k] + r0[3*x1 + k] +
+                        r1[6*x + k] + r1[3*x1 + k] + 2) >> 2;
+            }
+
+            *up++ = ((-38 * c[0] - 74 * c[1] + 112 * c[2] + 128) >> 8) + 128;
+            *vp++ = ((112 * c[0] - 94 * c[1] - 18 * c[2] + 128) >> 8) + 128;
+        }
+    }
+}
+
+static void *writer(void *arg)
+{
+    sdfvideo *v;
+
+    v = arg;
+
+    pthread_mutex_lock(&v->lock);
+
+    while (1) {
+        int slot;
+
+        slot = v->write;
+        while (v->state[slot] != SDFVIDEO_QUEUED && !v->quit) {
+            pthread_cond_wait(&v->cond, &v->lock);
+        }
+        if (v->state[slot] != SDFVIDEO_QUEUED) break;
+        pthread_mutex_unlock(&v->lock);
+
+        encode(v, v->canvas[slot]);
+
+        /* the canvas is free to draw into while this writes */
+        pthread_mutex_lock(&v->lock);
+        v->state[slot] = SDFVIDEO_FREE;
+        v->write = (slot + 1) % SDFVIDEO_BUFFERS;
+        pthread_cond_broadcast(&v->cond);
+        pthread_mutex_unlock(&v->lock);
+
+        if (write_all(v->fd, v->frame, v->framesz)) {
+            pthread_mutex_lock(&v->lock);
+            if (v->status == SDFVIDEO_OK) v->status = SDFVIDEO_IO;
+        } else {
+            pthread_mutex_lock(&v->lock);
+        }
+    }
+
+    pthread_mutex_unlock(&v->lock);
+
+    return NULL;
+}
+
+int sdfvideo_open(sdfvideo *v,
+                  int fd,
+                  int type,
+                  int width,
+                  int height,
+                  int format,
+                  int fps_num,
+                  int fps_den)
+{
+    int i;
+    size_t canvassz;
+
+    v->fd = fd;
+    v->type = type;
+    v->width = width;
+    v->height = height;
+    v->format = format;
+    v->draw = 0;
+    v->write = 0;
+    v->status = SDFVIDEO_OK;
+    v->quit = 0;
+    v->running = 0;
+    v->frame = NULL;
+    v->rgb = NULL;
+    v->quant = NULL;
+    for (i = 0; i < SDFVIDEO_BUFFERS; i++) {
+        v->canvas[i] = NULL;
+        v->state[i] = SDFVIDEO_FREE;
+    }
+
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->cond, NULL);
+
+    if (width <= 0 || height <= 0 || fps_num <= 0 || fps_den <= 0 ||
+        format == SDFBLEND_PLANAR ||
+        (type != SDFVIDEO_Y4M && type != SDFVIDEO_RGB)) {
+        v->status = SDFVIDEO_NOT_OK;
+        sdfvideo_close(v);
+        return SDFVIDEO_NOT_OK;
+    }
+
+    if (type == SDFVIDEO_Y4M) {
+        v->framesz = 6 + (size_t)width * height +
+                     2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    } else {
+        v->framesz = (size_t)width * height * 3;
+    }
+
+    canvassz = (size_t)width * height * sdfblend_pixsize(format);
+
+    v->frame = malloc(v->framesz);
+    v->rgb = malloc((size_t)width * 3 * 2);
+    for (i = 0; i < SDFVIDEO_BUFFERS; i++) v->canvas[i] = malloc(canvassz);
+
+    if (v->frame == NULL || v->rgb == NULL ||
+        v->canvas[0] == NULL || v->canvas[1] == NULL) {
+        v->status = SDFVIDEO_NOT_OK;
+        sdfvideo_close(v);
+        return SDFVIDEO_NOT_OK;
+    }
+
+    if (type == SDFVIDEO_Y4M) {
+        char hdr[128];
+        sprintf(hdr, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n",
+                width, height, fps_num, fps_den);
+        if (write_all(fd, hdr, strlen(hdr))) {
+            v->status = SDFVIDEO_IO;
+            sdfvideo_close(v);
+            return SDFVIDEO_IO;
+        }
+    }
+
+    /* without a thread, frames are written as they are submitted */
+    if (!pthread_create(&v->thread, NULL, writer, v)) v->running = 1;
+
+    return v->status;
+}
+
+void sdfvideo_quant(sdfvideo *v, const sdfblend_quant *q)
+{
+    pthread_mutex_lock(&v->lock);
+    v->quant = q;
+    pthread_mutex_unlock(&v->lock);
+}
+
+void *sdfvideo_canvas(sdfvideo *v)
+{
+    void *canvas;
+    int slot;
+
+    pthread_mutex_lock(&v->lock);
+    slot = v->draw;
+    while (v->state[slot] != SDFVIDEO_FREE) {
+        pthread_cond_wait(&v->cond, &v->lock);
+    }
+    v->state[slot] = SDFVIDEO_DRAWING;
+    canvas = v->canvas[slot];
+    pthread_mutex_unlock(&v->lock);
+
+    return canvas;
+}
+
+int sdfvideo_submit(sdfvideo *v)
+{
+    int slot;
+    int status;
+
+    slot = v->draw;
+    if (v->state[slot] != SDFVIDEO_DRAWING) return SDFVIDEO_NOT_OK;
+
+    if (!v->running) {
+        encode(v, v->canvas[slot]);
+        if (write_all(v->fd, v->frame, v->framesz)) v->status = SDFVIDEO_IO;
+        v->state[slot] = SDFVIDEO_FREE;
+        v->draw = (slot + 1) % SDFVIDEO_BUFFERS;
+        return v->status;
+    }
+
+    pthread_mutex_lock(&v->lock);
+    v->state[slot] = SDFVIDEO_QUEUED;
+    v->draw = (slot + 1) % SDFVIDEO_BUFFERS;
+    status = v->status;
+    pthread_cond_broadcast(&v->cond);
+    pthread_mutex_unlock(&v->lock);
+
+    return status;
+}
+
+int sdfvideo_close(sdfvideo *v)
+{
+    int i;
+
+    if (v->running) {
+        pthread_mutex_lock(&v->lock);
+        v->quit = 1;
+        pthread_cond_broadcast(&v->cond);
+        pthread_mutex_unlock(&v->lock);
+        pthread_join(v->thread, NULL);
+        v->running = 0;
+    }
+
+    pthread_mutex_destroy(&v->lock);
+    pthread_cond_destroy(&v->cond);
+
+    for (i = 0; i < SDFVIDEO_BUFFERS; i++) {
+        free(v->canvas[i]);
+        v->canvas[i] = NULL;
+    }
+    free(v->frame);
+    free(v->rgb);
+    v->frame = NULL;
+    v->rgb = NULL;
+
+    return v->status;
+}
@@ -0,0 +1,92 @@
+#ifndef SDF2D_SDFVIDEO_H
+#define SDF2D_SDFVIDEO_H
+
+typedef struct sdfvideo sdfvideo;
+
+/* canvases: one is drawn while the other is written */
+#define SDFVIDEO_BUFFERS 2
+
+enum {
+    SDFVIDEO_OK,
+    SDFVIDEO_NOT_OK,
+    SDFVIDEO_IO
+};
+
+enum {
+    /* YUV4MPEG2, 4:2:0 BT.601 limited range */
+    SDFVIDEO_Y4M,
+    /* packed 8-bit rgb frames, no header */
+    SDFVIDEO_RGB
+};
+
+#ifdef SDF2D_SDFVIDEO_PRIV
+enum {
+    SDFVIDEO_FREE,
+    SDFVIDEO_DRAWING,
+    SDFVIDEO_QUEUED
+};
+
+struct sdfvideo {
+    int fd;
+    int type;
+    int width;
+    int height;
+    int format;
+
+    void *canvas[SDFVIDEO_BUFFERS];
+    int state[SDFVIDEO_BUFFERS];
+    /* next canvas handed out, next one written */
+    int draw;
+    int write;
+
+    /* the writer's encoded frame, and a row pair of rgb */
+    unsigned char *frame;
+    size_t framesz;
+    unsigned char *rgb;
+    const sdfblend_quant *quant;
+
+    int status;
+    int quit;
+    int running;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+#endif
+
+size_t sdfvideo_sizeof(void);
+
+/* Start a stream of width x height frames on fd, a pipe to an
+ * encoder or a file, at fps_num / fps_den frames a second.
+ * Canvases are in an interleaved sdfblend format. The fd is
+ * not closed. A reader going away raises SIGPIPE as usual.
+ * On SDFVIDEO_OK, v is closed once with sdfvideo_close. On any
+ * error it has already been cleaned up and must not be closed.
+ */
+int sdfvideo_open(sdfvideo *v,
+                  int fd,
+                  int type,
+                  int width,
+                  int height,
+                  int format,
+                  int fps_num,
+                  int fps_den);
+
+/* quantise frames through q, see sdfwrite_quant */
+void sdfvideo_quant(sdfvideo *v, const sdfblend_quant *q);
+
+/* The canvas for the next frame, width pixels a row, waiting
+ * until it has been converted if it was the last but one.
+ * Its old contents are left as they were.
+ */
+void *sdfvideo_canvas(sdfvideo *v);
+
+/* The canvas from sdfvideo_canvas is finished. It is converted
+ * and written on the writer thread while the caller goes on
+ * to draw the next one.
+ */
+int sdfvideo_submit(sdfvideo *v);
+
+/* write the queued frames and free the canvases */
+int sdfvideo_close(sdfvideo *v);
+#endif
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include "mathc/mathc.h"
@@ -44,6 +45,14 @@ void sdfvm_init(sdfvm *vm)
     vm->nuniforms = 0;
     vm->pos = 0;
     vm->lastop = -1;
+    vm->paths = NULL;
+    vm->npaths = 0;
+    vm->fields = NULL;
+    vm->nfields = 0;
+
+    for (i = 0; i < SDFVM_NPREP; i++) {
+        vm->prep[i].op = -1;
+    }
 }
 
 static int get_stacklet(sdfvm *vm, sdfvm_stacklet **sp)
@@ -464,11 +473,47 @@ int sdfvm_subtract(sdfvm *vm)
     return 0;
 }
 
+/* Prepared shapes
+ *
+ * Shape opcodes look up their derived constants in a small
+ * cache keyed on the opcode and its arguments, so a program
+ * evaluated over many pixels only pays for the divides and
+ * square roots once. The slot is picked by instruction count,
+ * so each shape in a program tends to keep its own slot.
+ */
+
+static sdfvm_prep *get_prep(sdfvm *vm,
+                            int op,
+                            const float *key,
+                            int nkey,
+                            int *hit)
+{
+    sdfvm_prep *pr;
+    int i;
+
+    pr = &vm->prep[vm->pos % SDFVM_NPREP];
+
+    *hit = pr->op == op;
+    for (i = 0; *hit && i < nkey; i++) {
+        if (pr->key[i] != key[i]) *hit = 0;
+    }
+
+    if (!*hit) {
+        pr->op = op;
+        for (i = 0; i < nkey; i++) pr->key[i] = key[i];
+    }
+
+    return pr;
+}
+
 int sdfvm_ellipse(sdfvm *vm)
 {
     int rc;
     struct vec2 p, ab;
     float d;
+    sdfvm_prep *pr;
+    float key[2];
+    int hit;
 
     rc = 0;
 
@@ -477,7 +522,196 @@ int sdfvm_ellipse(sdfvm *vm)
     rc = sdfvm_pop_vec2(vm, &p);
     if (rc) return rc;
 
-    d = sdf_ellipse(p, ab);
+    key[0] = ab.x;
+    key[1] = ab.y;
+    pr = get_prep(vm, SDF_OP_ELLIPSE, key, 2, &hit);
+    if (!hit) sdf_ellipse_prepare(&pr->data.ellipse, ab);
+
+    d = sdf_ellipse_prepared(p, &pr->data.ellipse);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_rhombus(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p, b;
+    float d;
+    sdfvm_prep *pr;
+    float key[2];
+    int hit;
+
+    rc = sdfvm_pop_vec2(vm, &b);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    key[0] = b.x;
+    key[1] = b.y;
+    pr = get_prep(vm, SDF_OP_RHOMBUS, key, 2, &hit);
+    if (!hit) sdf_rhombus_prepare(&pr->data.rhombus, b);
+
+    d = sdf_rhombus_prepared(p, &pr->data.rhombus);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_star5(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float key[2];
+    float d;
+    sdfvm_prep *pr;
+    int hit;
+
+    /* r, rf */
+    rc = sdfvm_pop_scalar(vm, &key[1]);
+    if (rc) return rc;
+    rc = sdfvm_pop_scalar(vm, &key[0]);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pr = get_prep(vm, SDF_OP_STAR5, key, 2, &hit);
+    if (!hit) sdf_star5_prepare(&pr->data.star5, key[0], key[1]);
+
+    d = sdf_star5_prepared(p, &pr->data.star5);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_vesica(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float key[2];
+    float d;
+    sdfvm_prep *pr;
+    int hit;
+
+    /* r, d */
+    rc = sdfvm_pop_scalar(vm, &key[1]);
+    if (rc) return rc;
+    rc = sdfvm_pop_scalar(vm, &key[0]);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pr = get_prep(vm, SDF_OP_VESICA, key, 2, &hit);
+    if (!hit) sdf_vesica_prepare(&pr->data.vesica, key[0], key[1]);
+
+    d = sdf_vesica_prepared(p, &pr->data.vesica);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_egg(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float key[2];
+    float d;
+    sdfvm_prep *pr;
+    int hit;
+
+    /* ra, rb */
+    rc = sdfvm_pop_scalar(vm, &key[1]);
+    if (rc) return rc;
+    rc = sdfvm_pop_scalar(vm, &key[0]);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pr = get_prep(vm, SDF_OP_EGG, key, 2, &hit);
+    if (!hit) sdf_egg_prepare(&pr->data.egg, key[0], key[1]);
+
+    d = sdf_egg_prepared(p, &pr->data.egg);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_moon(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float key[3];
+    float d;
+    sdfvm_prep *pr;
+    int hit;
+
+    /* d, ra, rb */
+    rc = sdfvm_pop_scalar(vm, &key[2]);
+    if (rc) return rc;
+    rc = sdfvm_pop_scalar(vm, &key[1]);
+    if (rc) return rc;
+    rc = sdfvm_pop_scalar(vm, &key[0]);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pr = get_prep(vm, SDF_OP_MOON, key, 3, &hit);
+    if (!hit) sdf_moon_prepare(&pr->data.moon, key[0], key[1], key[2]);
+
+    d = sdf_moon_prepared(p, &pr->data.moon);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_path(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float fpos;
+    int pos;
+    struct sdf_path *path;
+    float d;
+
+    rc = sdfvm_pop_scalar(vm, &fpos);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pos = (int)fpos;
+    if (pos < 0 || pos >= vm->npaths) return SDFVM_OUT_OF_BOUNDS;
+    path = &vm->paths[pos];
+
+    d = sdf_path(path->segs, path->nsegs, p);
+
+    rc = sdfvm_push_scalar(vm, d);
+
+    return rc;
+}
+
+int sdfvm_field(sdfvm *vm)
+{
+    int rc;
+    struct vec2 p;
+    float fpos;
+    int pos;
+    float d;
+
+    rc = sdfvm_pop_scalar(vm, &fpos);
+    if (rc) return rc;
+    rc = sdfvm_pop_vec2(vm, &p);
+    if (rc) return rc;
+
+    pos = (int)fpos;
+    if (pos < 0 || pos >= vm->nfields) return SDFVM_OUT_OF_BOUNDS;
+
+    d = sdf_field(&vm->fields[pos], p);
 
     rc = sdfvm_push_scalar(vm, d);
 
@@ -510,6 +744,18 @@ void sdfvm_uniforms(sdfvm *vm, sdfvm_stacklet *reg, int nreg)
     vm->nuniforms = nreg;
 }
 
+void sdfvm_paths(sdfvm *vm, struct sdf_path *paths, int npaths)
+{
+    vm->paths = paths;
+    vm->npaths = npaths;
+}
+
+void sdfvm_fields(sdfvm *vm, const struct sdf_field *fields, int nfields)
+{
+    vm->fields = fields;
+    vm->nfields = nfields;
+}
+
 int sdfvm_uniget(sdfvm *vm, int pos, sdfvm_stacklet *out)
 {
     if (pos < 0 || pos >= vm->nuniforms) return SDFVM_OUT_OF_BOUNDS;
@@ -822,6 +1068,41 @@ int sdfvm_execute(sdfvm *vm,
                 rc = print_stackpos(vm);
                 if (rc) return rc;
                 break;
+            case SDF_OP_PATH:
+                n++;
+                rc = sdfvm_path(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_RHOMBUS:
+                n++;
+                rc = sdfvm_rhombus(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_STAR5:
+                n++;
+                rc = sdfvm_star5(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_VESICA:
+                n++;
+                rc = sdfvm_vesica(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_EGG:
+                n++;
+                rc = sdfvm_egg(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_MOON:
+                n++;
+                rc = sdfvm_moon(vm);
+                if (rc) return rc;
+                break;
+            case SDF_OP_FIELD:
+                n++;
+                rc = sdfvm_field(vm);
+                if (rc) return rc;
+                break;
             default:
                 return SDFVM_UNKNOWN;
         }
@@ -830,6 +1111,412 @@ int sdfvm_execute(sdfvm *vm,
     return 0;
 }
 
+/* Lipschitz estimate: a shadow run of the program that tracks,
+ * for every stack value, a bound on how fast it can change
+ * with the point, and its value when that is a known constant.
+ * A negative bound means unbounded.
+ */
+
+typedef struct {
+    int type;
+    float lip;
+    int known;
+    float v[3];
+} lip_value;
+
+typedef struct {
+    lip_value stack[SDFVM_STACKSIZE];
+    int pos;
+    lip_value registers[SDFVM_NREGISTERS];
+} lip_state;
+
+static float lip_max(float a, float b)
+{
+    if (a < 0 || b < 0) return -1;
+    return a > b ? a : b;
+}
+
+static float lip_sum(float a, float b)
+{
+    if (a < 0 || b < 0) return -1;
+    return a + b;
+}
+
+static float lip_scale(float a, float s)
+{
+    if (a < 0) return -1;
+    return a * fabs(s);
+}
+
+static int lip_pop(lip_state *ls, int type, lip_value *out)
+{
+    if (ls->pos <= 0) return SDFVM_STACK_UNDERFLOW;
+    if (type != SDFVM_NONE && ls->stack[ls->pos - 1].type != type) {
+        return SDFVM_WRONG_TYPE;
+    }
+    ls->pos--;
+    *out = ls->stack[ls->pos];
+    return 0;
+}
+
+static int lip_push(lip_state *ls, int type, float lip)
+{
+    lip_value *val;
+
+    if (ls->pos >= SDFVM_STACKSIZE) return SDFVM_STACK_OVERFLOW;
+    val = &ls->stack[ls->pos++];
+    val->type = type;
+    val->lip = lip;
+    val->known = 0;
+    val->v[0] = val->v[1] = val->v[2] = 0;
+    return 0;
+}
+
+static int lip_push_known(lip_state *ls, int type, float *v)
+{
+    lip_value *val;
+    int rc;
+
+    rc = lip_push(ls, type, 0);
+    if (rc) return rc;
+    val = &ls->stack[ls->pos - 1];
+    val->known = 1;
+    val->v[0] = v[0];
+    val->v[1] = v[1];
+    val->v[2] = v[2];
+    return 0;
+}
+
+/* pops a known constant index, for uniforms and registers */
+static int lip_index(lip_state *ls, int *idx)
+{
+    lip_value x;
+    int rc;
+
+    rc = lip_pop(ls, SDFVM_SCALAR, &x);
+    if (rc) return rc;
+    if (!x.known) return SDFVM_NOT_OK;
+    *idx = (int)x.v[0];
+    return 0;
+}
+
+/* Shapes are exact distances in their point argument, and are
+ * only trusted when every other argument is constant. A circle
+ * is |p| - r, so its radius may vary.
+ */
+static int lip_shape(lip_state *ls, int op, const int *types, int nargs)
+{
+    lip_value x, p;
+    float lip;
+    int i;
+    int rc;
+
+    lip = 0;
+
+    for (i = nargs - 1; i >= 0; i--) {
+        rc = lip_pop(ls, types[i], &x);
+        if (rc) return rc;
+        if (op == SDF_OP_CIRCLE) lip = lip_sum(lip, x.lip);
+        else if (x.lip != 0) lip = -1;
+    }
+
+    rc = lip_pop(ls, SDFVM_VEC2, &p);
+    if (rc) return rc;
+
+    return lip_push(ls, SDFVM_SCALAR, lip_sum(lip, p.lip));
+}
+
+static int lip_product(lip_state *ls, int type)
+{
+    lip_value x, y;
+    float lip;
+    int i, n;
+    int rc;
+
+    rc = lip_pop(ls, type, &y);
+    if (rc) return rc;
+    rc = lip_pop(ls, type, &x);
+    if (rc) return rc;
+
+    n = type == SDFVM_VEC2 ? 2 : 1;
+
+    if (x.known && y.known) {
+        float v[3];
+        v[0] = v[1] = v[2] = 0;
+        for (i = 0; i < n; i++) v[i] = x.v[i] * y.v[i];
+        return lip_push_known(ls, type, v);
+    }
+
+    if (x.lip == 0 && y.lip == 0) {
+        lip = 0;
+    } else if (x.known || y.known) {
+        lip_value *k, *u;
+        float s;
+
+        k = x.known ? &x : &y;
+        u = x.known ? &y : &x;
+        s = 0;
+        for (i = 0; i < n; i++) {
+            if (fabs(k->v[i]) > s) s = fabs(k->v[i]);
+        }
+        lip = lip_scale(u->lip, s);
+    } else {
+        lip = -1;
+    }
+
+    return lip_push(ls, type, lip);
+}
+
+static int lip_step(lip_state *ls,
+                    uint8_t op,
+                    float *f,
+                    sdfvm_stacklet *uniforms,
+                    int nuniforms)
+{
+    static const int circle[] = {SDFVM_SCALAR};
+    static const int poly4[] = {
+        SDFVM_VEC2, SDFVM_VEC2, SDFVM_VEC2, SDFVM_VEC2
+    };
+    static const int vec2[] = {SDFVM_VEC2};
+    static const int scalars[] = {
+        SDFVM_SCALAR, SDFVM_SCALAR, SDFVM_SCALAR
+    };
+    lip_value x, y, a;
+    float v[3];
+    int idx;
+    int rc;
+
+    v[0] = v[1] = v[2] = 0;
+
+    switch (op) {
+        case SDF_OP_POINT:
+            return lip_push(ls, SDFVM_VEC2, 1);
+        case SDF_OP_SWAP:
+            if (ls->pos < 2) return SDFVM_STACK_UNDERFLOW;
+            x = ls->stack[ls->pos - 1];
+            ls->stack[ls->pos - 1] = ls->stack[ls->pos - 2];
+            ls->stack[ls->pos - 2] = x;
+            return 0;
+        case SDF_OP_UNIFORM:
+            rc = lip_index(ls, &idx);
+            if (rc) return rc;
+            if (idx < 0 || idx >= nuniforms) return SDFVM_OUT_OF_BOUNDS;
+            switch (uniforms[idx].type) {
+                case SDFVM_SCALAR:
+                    v[0] = uniforms[idx].data.s;
+                    break;
+                case SDFVM_VEC2:
+                    v[0] = uniforms[idx].data.v2.x;
+                    v[1] = uniforms[idx].data.v2.y;
+                    break;
+                case SDFVM_VEC3:
+                    v[0] = uniforms[idx].data.v3.x;
+                    v[1] = uniforms[idx].data.v3.y;
+                    v[2] = uniforms[idx].data.v3.z;
+                    break;
+                default:
+                    return SDFVM_WRONG_TYPE;
+            }
+            return lip_push_known(ls, uniforms[idx].type, v);
+        case SDF_OP_REGGET:
+            rc = lip_index(ls, &idx);
+            if (rc) return rc;
+            if (idx < 0 || idx >= SDFVM_NREGISTERS) {
+                return SDFVM_OUT_OF_BOUNDS;
+            }
+            if (ls->registers[idx].type == SDFVM_NONE) return SDFVM_NOT_OK;
+            if (ls->pos >= SDFVM_STACKSIZE) return SDFVM_STACK_OVERFLOW;
+            ls->stack[ls->pos++] = ls->registers[idx];
+            return 0;
+        case SDF_OP_REGSET:
+            rc = lip_index(ls, &idx);
+            if (rc) return rc;
+            if (idx < 0 || idx >= SDFVM_NREGISTERS) {
+                return SDFVM_OUT_OF_BOUNDS;
+            }
+            return lip_pop(ls, SDFVM_NONE, &ls->registers[idx]);
+        case SDF_OP_COLOR:
+            return lip_push(ls, SDFVM_VEC3, 0);
+        case SDF_OP_SCALAR:
+            return lip_push_known(ls, SDFVM_SCALAR, f);
+        case SDF_OP_VEC2:
+            return lip_push_known(ls, SDFVM_VEC2, f);
+        case SDF_OP_VEC3:
+            return lip_push_known(ls, SDFVM_VEC3, f);
+        case SDF_OP_CIRCLE:
+            return lip_shape(ls, op, circle, 1);
+        case SDF_OP_POLY4:
+            return lip_shape(ls, op, poly4, 4);
+        case SDF_OP_ELLIPSE:
+        case SDF_OP_RHOMBUS:
+            return lip_shape(ls, op, vec2, 1);
+        case SDF_OP_PATH:
+            return lip_shape(ls, op, scalars, 1);
+        case SDF_OP_STAR5:
+        case SDF_OP_VESICA:
+        case SDF_OP_EGG:
+            return lip_shape(ls, op, scalars, 2);
+        case SDF_OP_MOON:
+            return lip_shape(ls, op, scalars, 3);
+        case SDF_OP_FIELD:
+            /* samples, not a distance, and not known here */
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_VEC2, &y);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_SCALAR, -1);
+        case SDF_OP_ROUNDNESS:
+        case SDF_OP_ONION:
+            rc = lip_pop(ls, SDFVM_SCALAR, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_SCALAR, lip_sum(x.lip, y.lip));
+        case SDF_OP_UNION:
+        case SDF_OP_SUBTRACT:
+            rc = lip_pop(ls, SDFVM_SCALAR, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_SCALAR, lip_max(x.lip, y.lip));
+        case SDF_OP_UNION_SMOOTH:
+            rc = lip_pop(ls, SDFVM_SCALAR, &a);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            if (a.lip != 0) return lip_push(ls, SDFVM_SCALAR, -1);
+            return lip_push(ls, SDFVM_SCALAR, lip_max(x.lip, y.lip));
+        case SDF_OP_MUL:
+        case SDF_OP_ADD:
+            /* add multiplies, like sdfvm_add */
+            return lip_product(ls, SDFVM_SCALAR);
+        case SDF_OP_MUL2:
+            return lip_product(ls, SDFVM_VEC2);
+        case SDF_OP_ADD2:
+            rc = lip_pop(ls, SDFVM_VEC2, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_VEC2, &x);
+            if (rc) return rc;
+            if (x.known && y.known) {
+                v[0] = x.v[0] + y.v[0];
+                v[1] = x.v[1] + y.v[1];
+                return lip_push_known(ls, SDFVM_VEC2, v);
+            }
+            return lip_push(ls, SDFVM_VEC2, lip_sum(x.lip, y.lip));
+        case SDF_OP_LERP:
+            rc = lip_pop(ls, SDFVM_SCALAR, &a);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            if (!a.known) {
+                if (a.lip == 0 && x.lip == 0 && y.lip == 0) {
+                    return lip_push(ls, SDFVM_SCALAR, 0);
+                }
+                return lip_push(ls, SDFVM_SCALAR, -1);
+            }
+            return lip_push(ls, SDFVM_SCALAR,
+                            lip_sum(lip_scale(y.lip, a.v[0]),
+                                    lip_scale(x.lip, 1 - a.v[0])));
+        case SDF_OP_NORMALIZE:
+            /* (2x - y) / y.y, so a constant y scales by 2 / y.y */
+            rc = lip_pop(ls, SDFVM_VEC2, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_VEC2, &x);
+            if (rc) return rc;
+            if (x.lip == 0 && y.lip == 0) {
+                return lip_push(ls, SDFVM_VEC2, 0);
+            }
+            if (!y.known || y.v[1] == 0) {
+                return lip_push(ls, SDFVM_VEC2, -1);
+            }
+            return lip_push(ls, SDFVM_VEC2,
+                            lip_scale(x.lip, 2 / y.v[1]));
+        case SDF_OP_GTZ:
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_SCALAR, x.lip == 0 ? 0 : -1);
+        case SDF_OP_FEATHER:
+            rc = lip_pop(ls, SDFVM_SCALAR, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &x);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_SCALAR,
+                            x.lip == 0 && y.lip == 0 ? 0 : -1);
+        case SDF_OP_LERP3:
+            rc = lip_pop(ls, SDFVM_VEC3, &y);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_VEC3, &x);
+            if (rc) return rc;
+            rc = lip_pop(ls, SDFVM_SCALAR, &a);
+            if (rc) return rc;
+            return lip_push(ls, SDFVM_VEC3,
+                            a.lip == 0 && x.lip == 0 && y.lip == 0 ?
+                            0 : -1);
+        case SDF_OP_STACKPOS:
+            return 0;
+        default:
+            break;
+    }
+
+    return SDFVM_UNKNOWN;
+}
+
+int sdfvm_lipschitz(const uint8_t *program,
+                    size_t sz,
+                    sdfvm_stacklet *uniforms,
+                    int nuniforms,
+                    float *lip)
+{
+    lip_state ls;
+    size_t n;
+    int i;
+    int rc;
+
+    *lip = 0;
+    if (sz <= 0) return SDFVM_NOT_OK;
+
+    ls.pos = 0;
+    for (i = 0; i < SDFVM_NREGISTERS; i++) {
+        ls.registers[i].type = SDFVM_NONE;
+    }
+
+    n = 0;
+
+    while (n < sz) {
+        uint8_t c;
+        float f[3];
+        int nf;
+
+        c = program[n++];
+        f[0] = f[1] = f[2] = 0;
+
+        nf = 0;
+        if (c == SDF_OP_SCALAR) nf = 1;
+        else if (c == SDF_OP_VEC2) nf = 2;
+        else if (c == SDF_OP_VEC3) nf = 3;
+
+        for (i = 0; i < nf; i++) {
+            rc = get_float(program, sz, &n, &f[i]);
+            if (rc) return rc;
+        }
+
+        rc = lip_step(&ls, c, f, uniforms, nuniforms);
+        if (rc) return rc;
+    }
+
+    if (ls.pos <= 0) return SDFVM_STACK_UNDERFLOW;
+    if (ls.stack[ls.pos - 1].type != SDFVM_SCALAR) return SDFVM_WRONG_TYPE;
+    if (ls.stack[ls.pos - 1].lip < 0) return SDFVM_NOT_OK;
+
+    *lip = ls.stack[ls.pos - 1].lip;
+
+    return SDFVM_OK;
+}
+
 const char *sdfvm_errors[] = {
     /* SDFVM_OK, */
     "okay!",
@@ -881,6 +1568,13 @@ void sdfvm_print_lookup_table(FILE *fp)
     fprintf(fp, "    \"regset\": %d,\n", SDF_OP_REGSET);
     fprintf(fp, "    \"ellipse\": %d,\n", SDF_OP_ELLIPSE);
     fprintf(fp, "    \"stackpos\": %d,\n", SDF_OP_STACKPOS);
+    fprintf(fp, "    \"path\": %d,\n", SDF_OP_PATH);
+    fprintf(fp, "    \"rhombus\": %d,\n", SDF_OP_RHOMBUS);
+    fprintf(fp, "    \"star5\": %d,\n", SDF_OP_STAR5);
+    fprintf(fp, "    \"vesica\": %d,\n", SDF_OP_VESICA);
+    fprintf(fp, "    \"egg\": %d,\n", SDF_OP_EGG);
+    fprintf(fp, "    \"moon\": %d,\n", SDF_OP_MOON);
+    fprintf(fp, "    \"field\": %d,\n", SDF_OP_FIELD);
     fprintf(fp, "    \"end\": %d\n", SDF_OP_END);
     fprintf(fp, "}\n");
 }
@@ -1012,6 +1706,34 @@ int sdfvm_dump(const uint8_t *program,
                 n++;
                 printf("STACKPOS\n");
                 break;
+            case SDF_OP_PATH:
+                n++;
+                printf("PATH\n");
+                break;
+            case SDF_OP_RHOMBUS:
+                n++;
+                printf("RHOMBUS\n");
+                break;
+            case SDF_OP_STAR5:
+                n++;
+                printf("STAR5\n");
+                break;
+            case SDF_OP_VESICA:
+                n++;
+                printf("VESICA\n");
+                break;
+            case SDF_OP_EGG:
+                n++;
+                printf("EGG\n");
+                break;
+            case SDF_OP_MOON:
+                n++;
+                printf("MOON\n");
+                break;
+            case SDF_OP_FIELD:
+                n++;
+                printf("FIELD\n");
+                break;
             default:
                 printf("UNKNOWN");
                 return SDFVM_UNKNOWN;
@@ -7,6 +7,7 @@ typedef struct sdfvm_stacklet sdfvm_stacklet;
 #ifdef SDF2D_SDFVM_PRIV
 #define SDFVM_STACKSIZE 16
 #define SDFVM_NREGISTERS 16
+#define SDFVM_NPREP 8
 enum {
     SDFVM_NONE,
     SDFVM_SCALAR,
@@ -23,6 +24,20 @@ struct sdfvm_stacklet {
     } data;
 };
 
+/* derived shape constants, keyed on opcode and arguments */
+typedef struct {
+    int op;
+    float key[4];
+    union {
+        struct sdf_rhombus_prep rhombus;
+        struct sdf_star5_prep star5;
+        struct sdf_vesica_prep vesica;
+        struct sdf_egg_prep egg;
+        struct sdf_ellipse_prep ellipse;
+        struct sdf_moon_prep moon;
+    } data;
+} sdfvm_prep;
+
 struct sdfvm {
     sdfvm_stacklet stack[SDFVM_STACKSIZE];
     struct vec2 p;
@@ -33,6 +48,11 @@ struct sdfvm {
     sdfvm_stacklet registers[SDFVM_NREGISTERS];
     int pos;
     int lastop;
+    struct sdf_path *paths;
+    int npaths;
+    const struct sdf_field *fields;
+    int nfields;
+    sdfvm_prep prep[SDFVM_NPREP];
 };
 
 enum {
@@ -75,6 +95,13 @@ enum {
     SDF_OP_SUBTRACT,
     SDF_OP_ELLIPSE,
     SDF_OP_STACKPOS,
+    SDF_OP_PATH,
+    SDF_OP_RHOMBUS,
+    SDF_OP_STAR5,
+    SDF_OP_VESICA,
+    SDF_OP_EGG,
+    SDF_OP_MOON,
+    SDF_OP_FIELD,
     SDF_OP_END
 };
 #endif
@@ -105,6 +132,12 @@ int sdfvm_register_get(sdfvm *vm, int pos, sdfvm_stacklet *out);
 int sdfvm_regset(sdfvm *vm);
 int sdfvm_regget(sdfvm *vm);
 int sdfvm_uniform(sdfvm *vm);
+void sdfvm_paths(sdfvm *vm, struct sdf_path *paths, int npaths);
+
+/* baked fields for SDF_OP_FIELD, which pops an index and a
+ * point, like SDF_OP_PATH. They stay the caller's.
+ */
+void sdfvm_fields(sdfvm *vm, const struct sdf_field *fields, int nfields);
 
 int sdfvm_circle(sdfvm *vm);
 int sdfvm_poly4(sdfvm *vm);
@@ -121,11 +154,30 @@ int sdfvm_onion(sdfvm *vm);
 int sdfvm_union(sdfvm *vm);
 int sdfvm_union_smooth(sdfvm *vm);
 int sdfvm_ellipse(sdfvm *vm);
+int sdfvm_path(sdfvm *vm);
+int sdfvm_rhombus(sdfvm *vm);
+int sdfvm_star5(sdfvm *vm);
+int sdfvm_vesica(sdfvm *vm);
+int sdfvm_egg(sdfvm *vm);
+int sdfvm_moon(sdfvm *vm);
+int sdfvm_field(sdfvm *vm);
 
 int sdfvm_execute(sdfvm *vm,
                   const uint8_t *program,
                   size_t sz);
 
+/* Bound on how fast the program's result can change with the
+ * point, for the given uniforms. SDFVM_NOT_OK if the program
+ * has no such bound (or it can't be shown), with *lip set to 0.
+ * Fields aren't known here, so programs using them have none;
+ * a draw of just a field can use the field's lipschitz.
+ */
+int sdfvm_lipschitz(const uint8_t *program,
+                    size_t sz,
+                    sdfvm_stacklet *uniforms,
+                    int nuniforms,
+                    float *lip);
+
 int sdfvm_dump(const uint8_t *program,
                size_t sz);
 
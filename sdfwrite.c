@@ -0,0 +1,1235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "mathc/mathc.h"
+#include "sdf.h"
+#include "sdfvm.h"
+#include "sdfblend.h"
+#include "sdfrender.h"
+#define SDF2D_SDFWRITE_PRIV
+#include "sdfwrite.h"
+
+enum {
+    SLOT_FULL,
+    SLOT_BUSY,
+    SLOT_DONE
+};
+
+/* deflate */
+#define WSIZE 32768
+#define WMASK (WSIZE - 1)
+#define HBITS 15
+#define HSIZE (1 << HBITS)
+#define MINMATCH 3
+#define MAXMATCH 258
+/* tokens per block, a block is closed when this fills */
+#define MAXTOK 16384
+
+#define FILTER_NONE 0
+#define FILTER_SUB 1
+#define FILTER_UP 2
+#define FILTER_AVG 3
+#define FILTER_PAETH 4
+/* pick per row, smallest sum of the bytes as signed */
+#define FILTER_ADAPT 5
+
+struct sdfwrite_z {
+    int head[HSIZE];
+    int prev[WSIZE];
+    /* a literal byte, or a match length when dist is non-zero */
+    unsigned short lit[MAXTOK];
+    unsigned short dist[MAXTOK];
+    int ntok;
+
+    /* the filtered band, what gets compressed */
+    unsigned char *filt;
+
+    unsigned char *out;
+    size_t pos;
+    unsigned long bits;
+    int nbits;
+};
+
+static const struct {
+    int filter;
+    int chain;
+    int nice;
+    int lazy;
+} levels[] = {
+    {FILTER_NONE, 0, 0, 0},
+    {FILTER_UP, 4, 16, 0},
+    {FILTER_ADAPT, 8, 32, 0},
+    {FILTER_ADAPT, 16, 64, 0},
+    {FILTER_ADAPT, 16, 64, 1},
+    {FILTER_ADAPT, 32, 128, 1},
+    {FILTER_ADAPT, 128, 128, 1},
+    {FILTER_ADAPT, 256, 258, 1},
+    {FILTER_ADAPT, 1024, 258, 1},
+    {FILTER_ADAPT, 4096, 258, 1}
+};
+
+static const unsigned short len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const unsigned char len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+
+static const unsigned char dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* order the code length code lengths are sent in */
+static const unsigned char cl_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* built once, by tables() */
+static unsigned long crc_table[256];
+static unsigned char len_code[MAXMATCH + 1];
+/* distance - 1 below 256, then 256 + ((distance - 1) >> 7) */
+static unsigned char dist_code[512];
+static unsigned char fixed_len[288];
+static unsigned short fixed_code[288];
+static unsigned char fixed_dlen[30];
+static unsigned short fixed_dcode[30];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+size_t sdfwrite_sizeof(void)
+{
+    return sizeof(sdfwrite);
+}
+
+/* canonical codes for the lengths, bit reversed for the
+ * least significant bit first stream
+ */
+static void huff_codes(const unsigned char *len,
+                       int n,
+                       unsigned short *code)
+{
+    int count[16];
+    int next[16];
+    int i, b;
+    int c;
+
+    for (b = 0; b < 16; b++) count[b] = 0;
+    for (i = 0; i < n; i++) count[len[i]]++;
+    count[0] = 0;
+
+    c = 0;
+    for (b = 1; b < 16; b++) {
+        c = (c + count[b - 1]) << 1;
+        next[b] = c;
+    }
+
+    for (i = 0; i < n; i++) {
+        int r;
+        int v;
+
+        if (len[i] == 0) continue;
+        v = next[len[i]]++;
+        r = 0;
+        for (b = 0; b < len[i]; b++) {
+            r = (r << 1) | (v & 1);
+            v >>= 1;
+        }
+        code[i] = r;
+    }
+}
+
+static void tables(void)
+{
+    int i, k;
+
+    for (i = 0; i < 256; i++) {
+        unsigned long c;
+        c = i;
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+
+    for (k = 0; k < 29; k++) {
+        int top;
+        top = len_base[k] + (1 << len_extra[k]) - 1;
+        for (i = len_base[k]; i <= top; i++) len_code[i] = k;
+    }
+    /* 258 has a code of its own, not 227 + 31 */
+    len_code[MAXMATCH] = 28;
+
+    for (k = 0; k < 30; k++) {
+        int top;
+        top = dist_base[k] + (1 << dist_extra[k]) - 1;
+        for (i = dist_base[k]; i <= top; i++) {
+            if (i <= 256) dist_code[i - 1] = k;
+            else dist_code[256 + ((i - 1) >> 7)] = k;
+        }
+    }
+
+    for (i = 0; i < 288; i++) {
+        if (i < 144) fixed_len[i] = 8;
+        else if (i < 256) fixed_len[i] = 9;
+        else if (i < 280) fixed_len[i] = 7;
+        else fixed_len[i] = 8;
+    }
+    huff_codes(fixed_len, 288, fixed_code);
+
+    for (i = 0; i < 30; i++) fixed_dlen[i] = 5;
+    huff_codes(fixed_dlen, 30, fixed_dcode);
+}
+
+static unsigned long crc32(unsigned long crc, const unsigned char *p, size_t n)
+{
+    size_t i;
+
+    crc ^= 0xffffffffUL;
+    for (i = 0; i < n; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xffffffffUL;
+}
+
+#define ADLER_BASE 65521UL
+
+static unsigned long adler32(unsigned long adler,
+                             const unsigned char *p,
+                             size_t n)
+{
+    unsigned long a, b;
+
+    a = adler & 0xffff;
+    b = adler >> 16;
+
+    while (n > 0) {
+        size_t k;
+
+        /* the most bytes before b can overflow 32 bits */
+        k = n < 5552 ? n : 5552;
+        n -= k;
+        while (k--) {
+            a += *p++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+
+    return a | (b << 16);
+}
+
+/* the adler32 of two runs, the second len2 bytes long */
+static unsigned long adler32_combine(unsigned long a1,
+                                     unsigned long a2,
+                                     size_t len2)
+{
+    unsigned long rem;
+    unsigned long s1, s2;
+
+    rem = len2 % ADLER_BASE;
+    s1 = a1 & 0xffff;
+    s2 = (rem * s1) % ADLER_BASE;
+    s1 += (a2 & 0xffff) + ADLER_BASE - 1;
+    s2 += ((a1 >> 16) & 0xffff) + ((a2 >> 16) & 0xffff) + ADLER_BASE - rem;
+    if (s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if (s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if (s2 >= (ADLER_BASE << 1)) s2 -= (ADLER_BASE << 1);
+    if (s2 >= ADLER_BASE) s2 -= ADLER_BASE;
+
+    return s1 | (s2 << 16);
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+    p[0] = (v >> 24) & 0xff;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+static int chunk(FILE *fp, const char *type, const unsigned char *p, size_t n)
+{
+    unsigned char hdr[8];
+    unsigned char tail[4];
+    unsigned long crc;
+
+    put32(hdr, n);
+    memcpy(hdr + 4, type, 4);
+    crc = crc32(0, hdr + 4, 4);
+    crc = crc32(crc, p, n);
+    put32(tail, crc);
+
+    if (fwrite(hdr, 1, 8, fp) != 8) return SDFWRITE_IO;
+    if (n > 0 && fwrite(p, 1, n, fp) != n) return SDFWRITE_IO;
+    if (fwrite(tail, 1, 4, fp) != 4) return SDFWRITE_IO;
+
+    return SDFWRITE_OK;
+}
+
+static void putbits(struct sdfwrite_z *z, unsigned long v, int n)
+{
+    z->bits |= v << z->nbits;
+    z->nbits += n;
+    while (z->nbits >= 8) {
+        z->out[z->pos++] = z->bits & 0xff;
+        z->bits >>= 8;
+        z->nbits -= 8;
+    }
+}
+
+static void align(struct sdfwrite_z *z)
+{
+    if (z->nbits > 0) putbits(z, 0, 8 - z->nbits);
+}
+
+/* Code lengths of at most maxbits for the frequencies. At
+ * least two codes are always given, so the code is complete.
+ * Too deep a tree is rebuilt with the frequencies halved.
+ */
+static void huff_lengths(const unsigned long *freq,
+                         int n,
+                         int maxbits,
+                         unsigned char *len)
+{
+    unsigned long f[288];
+    int leaf[288];
+    /* leaves first, then the nodes joining them */
+    unsigned long w[2 * 288];
+    int parent[2 * 288];
+    int alive[2 * 288];
+    int nleaf;
+    int i;
+
+    nleaf = 0;
+    for (i = 0; i < n; i++) {
+        len[i] = 0;
+        f[i] = freq[i];
+        if (f[i] > 0) leaf[nleaf++] = i;
+    }
+
+    while (nleaf < 2) {
+        i = (nleaf == 0 || leaf[0] != 0) ? 0 : 1;
+        f[i] = 1;
+        leaf[nleaf++] = i;
+    }
+
+    while (1) {
+        int nnode;
+        int depth;
+
+        for (i = 0; i < nleaf; i++) {
+            w[i] = f[leaf[i]];
+            parent[i] = -1;
+            alive[i] = 1;
+        }
+
+        nnode = nleaf;
+        while (1) {
+            int a, b;
+            int k;
+
+            a = b = -1;
+            for (k = 0; k < nnode; k++) {
+                if (!alive[k]) continue;
+                if (a < 0 || w[k] < w[a]) {
+                    b = a;
+                    a = k;
+                } else if (b < 0 || w[k] < w[b]) {
+                    b = k;
+                }
+            }
+            if (b < 0) break;
+
+            alive[a] = alive[b] = 0;
+            parent[a] = parent[b] = nnode;
+            parent[nnode] = -1;
+            alive[nnode] = 1;
+            w[nnode] = w[a] + w[b];
+            nnode++;
+        }
+
+        depth = 0;
+        for (i = 0; i < nleaf; i++) {
+            int d;
+            int k;
+            d = 0;
+            for (k = i; parent[k] >= 0; k = parent[k]) d++;
+            len[leaf[i]] = d;
+            if (d > depth) depth = d;
+        }
+
+        if (depth <= maxbits) break;
+
+        for (i = 0; i < nleaf; i++) {
+            f[leaf[i]] = (f[leaf[i]] + 1) >> 1;
+        }
+    }
+}
+
+static int longest_match(struct sdfwrite_z *z,
+                         const unsigned char *p,
+                         int i,
+                         int n,
+                         int cand,
+                         int chain,
+                         int nice,
+                         int *dist)
+{
+    int best;
+    int max;
+
+    best = 0;
+    max = n - i;
+    if (max > MAXMATCH) max = MAXMATCH;
+    if (nice > max) nice = max;
+
+    while (cand >= 0 && i - cand <= WSIZE && chain-- > 0) {
+        const unsigned char *a, *b;
+        int l;
+
+        a = p + cand;
+        b = p + i;
+        if (a[best] == b[best] && a[0] == b[0] && a[1] == b[1]) {
+            for (l = 2; l < max && a[l] == b[l]; l++);
+            if (l > best) {
+                best = l;
+                *dist = i - cand;
+                if (best >= nice) break;
+            }
+        }
+
+        cand = z->prev[cand & WMASK];
+    }
+
+    return best;
+}
+
+static int hash(const unsigned char *p)
+{
+    unsigned long v;
+    v = ((unsigned long)p[0] << 16) | (p[1] << 8) | p[2];
+    return ((v * 2654435761UL) & 0xffffffffUL) >> (32 - HBITS);
+}
+
+static void insert(struct sdfwrite_z *z, const unsigned char *p, int i)
+{
+    int h;
+    h = hash(p + i);
+    z->prev[i & WMASK] = z->head[h];
+    z->head[h] = i;
+}
+
+static void stored(struct sdfwrite_z *z, const unsigned char *p, int n)
+{
+    do {
+        int k;
+        k = n > 65535 ? 65535 : n;
+        putbits(z, 0, 3);
+        align(z);
+        putbits(z, k & 0xffff, 16);
+        putbits(z, ~k & 0xffff, 16);
+        if (k > 0) memcpy(z->out + z->pos, p, k);
+        z->pos += k;
+        p += k;
+        n -= k;
+    } while (n > 0);
+}
+
+static void put_tokens(struct sdfwrite_z *z,
+                       const unsigned char *llen,
+                       const unsigned short *lcode,
+                       const unsigned char *dlen,
+                       const unsigned short *dcode)
+{
+    int t;
+
+    for (t = 0; t < z->ntok; t++) {
+        int c;
+        int l, d;
+
+        if (z->dist[t] == 0) {
+            putbits(z, lcode[z->lit[t]], llen[z->lit[t]]);
+            continue;
+        }
+
+        l = z->lit[t];
+        c = len_code[l];
+        putbits(z, lcode[257 + c], llen[257 + c]);
+        putbits(z, l - len_base[c], len_extra[c]);
+
+        d = z->dist[t];
+        c = d <= 256 ? dist_code[d - 1] : dist_code[256 + ((d - 1) >> 7)];
+        putbits(z, dcode[c], dlen[c]);
+        putbits(z, d - dist_base[c], dist_extra[c]);
+    }
+
+    putbits(z, lcode[256], llen[256]);
+}
+
+/* Write the tokens as one non-final block, of whichever type
+ * comes out smallest. p .. p + n are the bytes they cover.
+ */
+static void block(struct sdfwrite_z *z, const unsigned char *p, int n)
+{
+    unsigned long lfreq[286];
+    unsigned long dfreq[30];
+    unsigned long clfreq[19];
+    unsigned char llen[286];
+    unsigned char dlen[30];
+    unsigned char cllen[19];
+    unsigned short lcode[286];
+    unsigned short dcode[30];
+    unsigned short clcode[19];
+    unsigned char lens[286 + 30];
+    unsigned char clsym[286 + 30];
+    unsigned char clext[286 + 30];
+    unsigned long extra;
+    unsigned long fixed, dynamic, store;
+    int nlit, ndist, nlens, ncl, nclen;
+    int i, t;
+
+    if (z->ntok == 0) return;
+
+    for (i = 0; i < 286; i++) lfreq[i] = 0;
+    for (i = 0; i < 30; i++) dfreq[i] = 0;
+
+    extra = 0;
+    for (t = 0; t < z->ntok; t++) {
+        int c, d;
+
+        if (z->dist[t] == 0) {
+            lfreq[z->lit[t]]++;
+            continue;
+        }
+
+        c = len_code[z->lit[t]];
+        lfreq[257 + c]++;
+        extra += len_extra[c];
+
+        d = z->dist[t];
+        c = d <= 256 ? dist_code[d - 1] : dist_code[256 + ((d - 1) >> 7)];
+        dfreq[c]++;
+        extra += dist_extra[c];
+    }
+    lfreq[256] = 1;
+
+    huff_lengths(lfreq, 286, 15, llen);
+    huff_lengths(dfreq, 30, 15, dlen);
+
+    for (nlit = 286; nlit > 257 && llen[nlit - 1] == 0; nlit--);
+    for (ndist = 30; ndist > 1 && dlen[ndist - 1] == 0; ndist--);
+
+    /* run length code the lengths */
+    memcpy(lens, llen, nlit);
+    memcpy(lens + nlit, dlen, ndist);
+    nlens = nlit + ndist;
+
+    ncl = 0;
+    for (i = 0; i < 19; i++) clfreq[i] = 0;
+    for (i = 0; i < nlens;) {
+        int run;
+        int l;
+
+        l = lens[i];
+        for (run = 1; i + run < nlens && lens[i + run] == l; run++);
+
+        if (l == 0 && run >= 3) {
+            if (run > 138) run = 138;
+            clsym[ncl] = run >= 11 ? 18 : 17;
+            clext[ncl] = run >= 11 ? run - 11 : run - 3;
+        } else if (l != 0 && run >= 4) {
+            /* the length itself, then repeats of it */
+            clsym[ncl] = l;
+            clfreq[l]++;
+            ncl++;
+            run--;
+            if (run > 6) run = 6;
+            clsym[ncl] = 16;
+            clext[ncl] = run - 3;
+            i++;
+        } else {
+            run = 1;
+            clsym[ncl] = l;
+        }
+
+        clfreq[clsym[ncl]]++;
+        ncl++;
+        i += run;
+    }
+
+    huff_lengths(clfreq, 19, 7, cllen);
+    for (nclen = 19; nclen > 4 && cllen[cl_order[nclen - 1]] == 0; nclen--);
+
+    dynamic = 3 + 5 + 5 + 4 + 3 * nclen + extra;
+    for (i = 0; i < ncl; i++) {
+        dynamic += cllen[clsym[i]];
+        if (clsym[i] == 16) dynamic += 2;
+        else if (clsym[i] == 17) dynamic += 3;
+        else if (clsym[i] == 18) dynamic += 7;
+    }
+
+    fixed = 3 + extra;
+    for (i = 0; i < 286; i++) {
+        dynamic += lfreq[i] * llen[i];
+        fixed += lfreq[i] * fixed_len[i];
+    }
+    for (i = 0; i < 30; i++) {
+        dynamic += dfreq[i] * dlen[i];
+        fixed += dfreq[i] * 5;
+    }
+
+    store = ((unsigned long)n / 65535 + 1) * (3 + 7 + 32) + 8UL * n;
+
+    if (store <= fixed && store <= dynamic) {
+        stored(z, p, n);
+    } else if (fixed <= dynamic) {
+        putbits(z, 2, 3);
+        put_tokens(z, fixed_len, fixed_code, fixed_dlen, fixed_dcode);
+    } else {
+        huff_codes(llen, nlit, lcode);
+        huff_codes(dlen, ndist, dcode);
+        huff_codes(cllen, 19, clcode);
+
+        putbits(z, 4, 3);
+        putbits(z, nlit - 257, 5);
+        putbits(z, ndist - 1, 5);
+        putbits(z, nclen - 4, 4);
+        for (i = 0; i < nclen; i++) putbits(z, cllen[cl_order[i]], 3);
+
+        for (i = 0; i < ncl; i++) {
+            putbits(z, clcode[clsym[i]], cllen[clsym[i]]);
+            if (clsym[i] == 16) putbits(z, clext[i], 2);
+            else if (clsym[i] == 17) putbits(z, clext[i], 3);
+            else if (clsym[i] == 18) putbits(z, clext[i], 7);
+        }
+
+        put_tokens(z, llen, lcode, dlen, dcode);
+    }
+
+    z->ntok = 0;
+}
+
+static void literal(struct sdfwrite_z *z, int c)
+{
+    z->lit[z->ntok] = c;
+    z->dist[z->ntok] = 0;
+    z->ntok++;
+}
+
+static void match(struct sdfwrite_z *z, int len, int dist)
+{
+    z->lit[z->ntok] = len;
+    z->dist[z->ntok] = dist;
+    z->ntok++;
+}
+
+/* deflate n bytes as blocks ending on a byte boundary, with
+ * no references outside them
+ */
+static void deflate(struct sdfwrite_z *z,
+                    const unsigned char *p,
+                    int n,
+                    int level)
+{
+    int chain, nice, lazy;
+    int start;
+    int i;
+    int len, dist;
+    int have;
+
+    if (level == 0) {
+        stored(z, p, n);
+        return;
+    }
+
+    chain = levels[level].chain;
+    nice = levels[level].nice;
+    lazy = levels[level].lazy;
+
+    for (i = 0; i < HSIZE; i++) z->head[i] = -1;
+    z->ntok = 0;
+
+    start = 0;
+    have = 0;
+    len = dist = 0;
+    for (i = 0; i < n;) {
+        if (z->ntok >= MAXTOK - 1) {
+            block(z, p + start, i - start);
+            start = i;
+        }
+
+        if (!have) {
+            len = 0;
+            if (i + MINMATCH <= n) {
+                len = longest_match(z, p, i, n, z->head[hash(p + i)],
+                                    chain, nice, &dist);
+                insert(z, p, i);
+            }
+        }
+        have = 0;
+
+        if (len >= MINMATCH && lazy && len < nice && i + 1 + MINMATCH <= n) {
+            int len2, dist2;
+
+            len2 = longest_match(z, p, i + 1, n, z->head[hash(p + i + 1)],
+                                 chain, nice, &dist2);
+            insert(z, p, i + 1);
+
+            if (len2 > len) {
+                literal(z, p[i]);
+                i++;
+                len = len2;
+                dist = dist2;
+                have = 1;
+                continue;
+            }
+
+            match(z, len, dist);
+            for (len += i, i += 2; i < len; i++) {
+                if (i + MINMATCH <= n) insert(z, p, i);
+            }
+            continue;
+        }
+
+        if (len >= MINMATCH) {
+            match(z, len, dist);
+            for (len += i, i++; i < len; i++) {
+                if (i + MINMATCH <= n) insert(z, p, i);
+            }
+        } else {
+            literal(z, p[i]);
+            i++;
+        }
+    }
+
+    block(z, p + start, n - start);
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p, pa, pb, pc;
+
+    p = a + b - c;
+    pa = abs(p - a);
+    pb = abs(p - b);
+    pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+/* one png row, 3 bytes a pixel, from row cur under row up */
+static void filter(unsigned char *out,
+                   const unsigned char *cur,
+                   const unsigned char *up,
+                   int n,
+                   int type)
+{
+    int i;
+
+    if (type == FILTER_ADAPT) {
+        unsigned long sum[5];
+        int k;
+
+        for (k = 0; k < 5; k++) sum[k] = 0;
+
+        for (i = 0; i < n; i++) {
+            int a, b, c, x;
+
+            a = i >= 3 ? cur[i - 3] : 0;
+            b = up[i];
+            c = i >= 3 ? up[i - 3] : 0;
+            x = cur[i];
+
+            sum[0] += abs((signed char)x);
+            sum[1] += abs((signed char)(x - a));
+            sum[2] += abs((signed char)(x - b));
+            sum[3] += abs((signed char)(x - ((a + b) >> 1)));
+            sum[4] += abs((signed char)(x - paeth(a, b, c)));
+        }
+
+        type = FILTER_NONE;
+        for (k = 1; k < 5; k++) {
+            if (sum[k] < sum[type]) type = k;
+        }
+    }
+
+    out[0] = type;
+    out++;
+
+    for (i = 0; i < n; i++) {
+        int a, b, c;
+
+        a = i >= 3 ? cur[i - 3] : 0;
+        b = up[i];
+        c = i >= 3 ? up[i - 3] : 0;
+
+        switch (type) {
+            case FILTER_SUB:
+                out[i] = cur[i] - a;
+                break;
+            case FILTER_UP:
+                out[i] = cur[i] - b;
+                break;
+            case FILTER_AVG:
+                out[i] = cur[i] - ((a + b) >> 1);
+                break;
+            case FILTER_PAETH:
+                out[i] = cur[i] - paeth(a, b, c);
+                break;
+            default:
+                out[i] = cur[i];
+                break;
+        }
+    }
+}
+
+/* filter and deflate a slot into its IDAT chunk */
+static void compress(sdfwrite *wr, int slot, struct sdfwrite_z *z)
+{
+    unsigned char *px;
+    unsigned char *out;
+    size_t rowsz;
+    int nrows;
+    int y;
+    size_t n;
+
+    px = wr->ring + slot * wr->slotsz;
+    out = wr->out + slot * wr->outcap;
+    nrows = wr->rows[slot];
+    rowsz = (size_t)wr->width * 3;
+
+    for (y = 0; y < nrows; y++) {
+        filter(z->filt + y * (rowsz + 1),
+               px + wr->pre + y * rowsz,
+               px + wr->pre + (y - 1) * rowsz,
+               rowsz,
+               levels[wr->level].filter);
+    }
+
+    n = nrows * (rowsz + 1);
+    wr->adler[slot] = adler32(1, z->filt, n);
+
+    z->out = out + 8;
+    z->pos = 0;
+    z->bits = 0;
+    z->nbits = 0;
+    deflate(z, z->filt, n, wr->level);
+
+    /* sync flush: an empty stored block */
+    stored(z, NULL, 0);
+
+    put32(out, z->pos);
+    memcpy(out + 4, "IDAT", 4);
+    put32(out + 8 + z->pos, crc32(0, out + 4, z->pos + 4));
+    wr->outsz[slot] = z->pos + 12;
+}
+
+/* write out a slot, in order */
+static void emit(sdfwrite *wr, int slot)
+{
+    unsigned char *p;
+    size_t sz;
+
+    if (wr->type == SDFWRITE_PNG) {
+        p = wr->out + slot * wr->outcap;
+        sz = wr->outsz[slot];
+        wr->sum = adler32_combine(wr->sum, wr->adler[slot],
+                                  wr->rows[slot] * (wr->width * 3 + 1));
+    } else {
+        p = wr->ring + slot * wr->slotsz;
+        sz = (size_t)wr->rows[slot] * wr->width * 3;
+    }
+
+    if (fwrite(p, 1, sz, wr->fp) != sz) {
+        if (wr->status == SDFWRITE_OK) wr->status = SDFWRITE_IO;
+    }
+}
+
+static int next_full(sdfwrite *wr)
+{
+    int i;
+
+    for (i = 0; i < wr->count; i++) {
+        int slot;
+        slot = (wr->head + i) % SDFWRITE_RING;
+        if (wr->state[slot] == SLOT_FULL) return slot;
+    }
+
+    return -1;
+}
+
+/* Compresses slots as they fill, and writes out the oldest
+ * once it is done. One thread writes at a time.
+ */
+static void *writer(void *arg)
+{
+    sdfwrite *wr;
+    struct sdfwrite_z *z;
+
+    wr = arg;
+
+    pthread_mutex_lock(&wr->lock);
+    z = wr->z[wr->started++];
+
+    while (1) {
+        int slot;
+
+        if (!wr->writing &&
+            wr->count > 0 &&
+            wr->state[wr->head] == SLOT_DONE) {
+            slot = wr->head;
+            wr->writing = 1;
+            pthread_mutex_unlock(&wr->lock);
+            emit(wr, slot);
+            pthread_mutex_lock(&wr->lock);
+            wr->writing = 0;
+            wr->head = (wr->head + 1) % SDFWRITE_RING;
+            wr->count--;
+            pthread_cond_broadcast(&wr->cond);
+            continue;
+        }
+
+        slot = next_full(wr);
+        if (slot >= 0) {
+            wr->state[slot] = SLOT_BUSY;
+            pthread_mutex_unlock(&wr->lock);
+            compress(wr, slot, z);
+            pthread_mutex_lock(&wr->lock);
+            wr->state[slot] = SLOT_DONE;
+            pthread_cond_broadcast(&wr->cond);
+            continue;
+        }
+
+        if (wr->count == 0 && wr->quit) break;
+        pthread_cond_wait(&wr->cond, &wr->lock);
+    }
+
+    pthread_mutex_unlock(&wr->lock);
+
+    return NULL;
+}
+
+static void release(sdfwrite *wr)
+{
+    int i;
+
+    for (i = 0; i < SDFWRITE_RING; i++) {
+        if (wr->z[i] != NULL) {
+            free(wr->z[i]->filt);
+            free(wr->z[i]);
+            wr->z[i] = NULL;
+        }
+    }
+
+    free(wr->ring);
+    free(wr->out);
+    wr->ring = NULL;
+    wr->out = NULL;
+}
+
+static int begin(sdfwrite *wr,
+                 const char *filename,
+                 int width,
+                 int height,
+                 int type,
+                 int level,
+                 int nthreads)
+{
+    int i;
+
+    wr->fp = NULL;
+    wr->ring = NULL;
+    wr->out = NULL;
+    wr->width = width;
+    wr->height = height;
+    wr->type = type;
+    wr->level = level;
+    wr->y = 0;
+    wr->nrows = 0;
+    wr->head = 0;
+    wr->count = 0;
+    wr->fill = 0;
+    wr->sum = 1;
+    wr->quant = NULL;
+    wr->status = SDFWRITE_OK;
+    wr->quit = 0;
+    wr->writing = 0;
+    wr->nthreads = 0;
+    wr->started = 0;
+    for (i = 0; i < SDFWRITE_RING; i++) wr->z[i] = NULL;
+
+    if (width <= 0 || height <= 0) return SDFWRITE_NOT_OK;
+
+    wr->pre = type == SDFWRITE_PNG ? (size_t)width * 3 : 0;
+    wr->slotsz = wr->pre + (size_t)SDFWRITE_BAND * width * 3;
+    wr->ring = malloc(SDFWRITE_RING * wr->slotsz);
+    if (wr->ring == NULL) return SDFWRITE_NOT_OK;
+
+    if (type == SDFWRITE_PNG) {
+        size_t raw;
+
+        /* no block is written bigger than stored, plus the
+         * chunk header, crc and sync flush
+         */
+        raw = (size_t)SDFWRITE_BAND * (width * 3 + 1);
+        wr->outcap = raw + raw / 1000 + 64;
+        wr->out = malloc(SDFWRITE_RING * wr->outcap);
+        if (wr->out == NULL) {
+            release(wr);
+            return SDFWRITE_NOT_OK;
+        }
+
+        /* one for compressing inline if no thread starts */
+        for (i = 0; i < (nthreads > 0 ? nthreads : 1); i++) {
+            wr->z[i] = malloc(sizeof(struct sdfwrite_z));
+            if (wr->z[i] == NULL) break;
+            wr->z[i]->filt = malloc(raw);
+            if (wr->z[i]->filt == NULL) break;
+        }
+
+        if (i < (nthreads > 0 ? nthreads : 1)) {
+            release(wr);
+            return SDFWRITE_NOT_OK;
+        }
+    }
+
+    wr->fp = fopen(filename, "wb");
+    if (wr->fp == NULL) {
+        release(wr);
+        return SDFWRITE_OPEN;
+    }
+
+    pthread_mutex_init(&wr->lock, NULL);
+    pthread_cond_init(&wr->cond, NULL);
+
+    return SDFWRITE_OK;
+}
+
+/* after the header. without threads, slots are written as they fill */
+static void start(sdfwrite *wr, int nthreads)
+{
+    int i;
+
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&wr->thread[i], NULL, writer, wr)) break;
+        wr->nthreads++;
+    }
+}
+
+int sdfwrite_begin(sdfwrite *wr, const char *filename, int width, int height)
+{
+    int rc;
+
+    rc = begin(wr, filename, width, height, SDFWRITE_PPM, 0, 1);
+    if (rc) return rc;
+
+    if (fprintf(wr->fp, "P6\n%d %d\n%d\n", width, height, 255) < 0) {
+        wr->status = SDFWRITE_IO;
+    }
+
+    start(wr, 1);
+
+    return SDFWRITE_OK;
+}
+
+int sdfwrite_begin_png(sdfwrite *wr,
+                       const char *filename,
+                       int width,
+                       int height,
+                       int level)
+{
+    static const unsigned char sig[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    unsigned char ihdr[13];
+    unsigned char zhdr[2];
+    int nthreads;
+    int rc;
+
+    if (level < 0 || level > SDFWRITE_BEST) return SDFWRITE_NOT_OK;
+
+    pthread_once(&tables_once, tables);
+
+    nthreads = sdfrender_ncpus();
+    if (nthreads > SDFWRITE_RING) nthreads = SDFWRITE_RING;
+
+    rc = begin(wr, filename, width, height, SDFWRITE_PNG, level, nthreads);
+    if (rc) return rc;
+
+    put32(ihdr, width);
+    put32(ihdr + 4, height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+
+    /* zlib header, 32k window, with the level as a hint */
+    zhdr[0] = 0x78;
+    if (level <= SDFWRITE_FAST) zhdr[1] = 0x01;
+    else if (level < SDFWRITE_DEFAULT) zhdr[1] = 0x5e;
+    else if (level == SDFWRITE_DEFAULT) zhdr[1] = 0x9c;
+    else zhdr[1] = 0xda;
+
+    if (fwrite(sig, 1, 8, wr->fp) != 8 ||
+        chunk(wr->fp, "IHDR", ihdr, 13) ||
+        chunk(wr->fp, "IDAT", zhdr, 2)) {
+        wr->status = SDFWRITE_IO;
+    }
+
+    start(wr, nthreads);
+
+    return SDFWRITE_OK;
+}
+
+/* hand the slot being filled to the threads */
+static void queue(sdfwrite *wr)
+{
+    int slot;
+
+    if (wr->nrows == 0) return;
+
+    slot = wr->fill;
+
+    pthread_mutex_lock(&wr->lock);
+    wr->rows[slot] = wr->nrows;
+    wr->state[slot] = wr->type == SDFWRITE_PNG ? SLOT_FULL : SLOT_DONE;
+    wr->count++;
+    pthread_cond_broadcast(&wr->cond);
+    pthread_mutex_unlock(&wr->lock);
+
+    wr->nrows = 0;
+
+    if (wr->nthreads == 0) {
+        if (wr->type == SDFWRITE_PNG) compress(wr, slot, wr->z[0]);
+        emit(wr, slot);
+        wr->head = (wr->head + 1) % SDFWRITE_RING;
+        wr->count--;
+    }
+}
+
+void sdfwrite_quant(sdfwrite *wr, const sdfblend_quant *q)
+{
+    wr->quant = q;
+}
+
+int sdfwrite_rows(sdfwrite *wr,
+                  const void *buf,
+                  int format,
+                  int stride,
+                  int nrows)
+{
+    int i;
+    size_t rowsz;
+    size_t rgbsz;
+
+    if (wr->fp == NULL || format == SDFBLEND_PLANAR) return SDFWRITE_NOT_OK;
+    if (wr->y + nrows > wr->height) return SDFWRITE_NOT_OK;
+
+    rowsz = sdfblend_pixsize(format) * stride;
+    rgbsz = (size_t)wr->width * 3;
+
+    for (i = 0; i < nrows; i++) {
+        unsigned char *out;
+
+        if (wr->nrows == 0) {
+            /* wait for a free slot */
+            pthread_mutex_lock(&wr->lock);
+            while (wr->count >= SDFWRITE_RING) {
+                pthread_cond_wait(&wr->cond, &wr->lock);
+            }
+            wr->fill = (wr->head + wr->count) % SDFWRITE_RING;
+            pthread_mutex_unlock(&wr->lock);
+
+            /* The row above, for the filters. The slot before
+             * is only reused after this one, so it is intact.
+             */
+            if (wr->pre > 0) {
+                out = wr->ring + wr->fill * wr->slotsz;
+                if (wr->y == 0) {
+                    memset(out, 0, wr->pre);
+                } else {
+                    int last;
+                    last = (wr->fill + SDFWRITE_RING - 1) % SDFWRITE_RING;
+                    memcpy(out,
+                           wr->ring + last * wr->slotsz + wr->pre +
+                           (SDFWRITE_BAND - 1) * rgbsz,
+                           rgbsz);
+                }
+            }
+        }
+
+        out = wr->ring + wr->fill * wr->slotsz + wr->pre;
+        out += wr->nrows * rgbsz;
+        if (wr->quant != NULL) {
+            sdfblend_rgb8_quant(out, (const unsigned char *)buf + i * rowsz,
+                                format, wr->width, wr->quant, 0, wr->y);
+        } else {
+            sdfblend_rgb8(out, (const unsigned char *)buf + i * rowsz,
+                          format, wr->width);
+        }
+
+        wr->y++;
+        wr->nrows++;
+        if (wr->nrows == SDFWRITE_BAND) queue(wr);
+    }
+
+    return wr->status;
+}
+
+int sdfwrite_end(sdfwrite *wr)
+{
+    int status;
+    int i;
+
+    if (wr->fp == NULL) return SDFWRITE_NOT_OK;
+
+    queue(wr);
+
+    pthread_mutex_lock(&wr->lock);
+    wr->quit = 1;
+    pthread_cond_broadcast(&wr->cond);
+    pthread_mutex_unlock(&wr->lock);
+
+    for (i = 0; i < wr->nthreads; i++) pthread_join(wr->thread[i], NULL);
+
+    if (wr->type == SDFWRITE_PNG) {
+        unsigned char tail[6];
+
+        /* an empty final block, then the adler32 of it all */
+        tail[0] = 0x03;
+        tail[1] = 0x00;
+        put32(tail + 2, wr->sum);
+
+        if (chunk(wr->fp, "IDAT", tail, 6) ||
+            chunk(wr->fp, "IEND", NULL, 0)) {
+            if (wr->status == SDFWRITE_OK) wr->status = SDFWRITE_IO;
+        }
+    }
+
+    pthread_mutex_destroy(&wr->lock);
+    pthread_cond_destroy(&wr->cond);
+
+    status = wr->status;
+    if (fclose(wr->fp) && status == SDFWRITE_OK) status = SDFWRITE_IO;
+    if (status == SDFWRITE_OK && wr->y < wr->height) status = SDFWRITE_NOT_OK;
+
+    release(wr);
+    wr->fp = NULL;
+
+    return status;
+}
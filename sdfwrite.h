@@ -0,0 +1,116 @@
+#ifndef SDF2D_SDFWRITE_H
+#define SDF2D_SDFWRITE_H
+
+typedef struct sdfwrite sdfwrite;
+
+/* rows per ring buffer, and buffers in the ring */
+#define SDFWRITE_BAND 32
+#define SDFWRITE_RING 8
+
+/* png levels, 0 stores without compressing */
+#define SDFWRITE_FAST 1
+#define SDFWRITE_DEFAULT 6
+#define SDFWRITE_BEST 9
+
+enum {
+    SDFWRITE_OK,
+    SDFWRITE_NOT_OK,
+    SDFWRITE_OPEN,
+    SDFWRITE_IO
+};
+
+enum {
+    SDFWRITE_PPM,
+    SDFWRITE_PNG
+};
+
+#ifdef SDF2D_SDFWRITE_PRIV
+struct sdfwrite_z;
+
+struct sdfwrite {
+    FILE *fp;
+    int width;
+    int height;
+    int type;
+    int level;
+
+    /* rows taken, and rows in the slot being filled */
+    int y;
+    int nrows;
+
+    /* slots head .. head + count - 1 wait for the writer,
+     * the caller fills slot fill, the one after them.
+     * A slot is pre bytes (the row above it, for png filters)
+     * and then SDFWRITE_BAND rows of rgb.
+     */
+    unsigned char *ring;
+    size_t slotsz;
+    size_t pre;
+    int rows[SDFWRITE_RING];
+    int state[SDFWRITE_RING];
+    int head;
+    int count;
+    int fill;
+
+    /* png: each slot compresses to a whole IDAT chunk */
+    unsigned char *out;
+    size_t outcap;
+    size_t outsz[SDFWRITE_RING];
+    unsigned long adler[SDFWRITE_RING];
+    unsigned long sum;
+
+    const sdfblend_quant *quant;
+
+    int status;
+    int quit;
+    int writing;
+    int nthreads;
+    int started;
+    pthread_t thread[SDFWRITE_RING];
+    struct sdfwrite_z *z[SDFWRITE_RING];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+#endif
+
+size_t sdfwrite_sizeof(void);
+
+/* Open filename and write a binary PPM header. Rows are handed
+ * to a writer thread through a ring of SDFWRITE_RING bands, so
+ * memory stays bounded whatever the image size.
+ */
+int sdfwrite_begin(sdfwrite *wr, const char *filename, int width, int height);
+
+/* Like sdfwrite_begin, but an 8-bit rgb PNG. Each band is
+ * filtered and deflated on its own by a pool of threads and
+ * ends on a byte boundary, so the bands are concatenated
+ * into one zlib stream in order. level is 0 to SDFWRITE_BEST.
+ */
+int sdfwrite_begin_png(sdfwrite *wr,
+                       const char *filename,
+                       int width,
+                       int height,
+                       int level);
+
+/* Quantise through q from here on instead of truncating,
+ * see sdfblend_quant. q is the caller's and must outlive the
+ * image. NULL goes back to truncating.
+ */
+void sdfwrite_quant(sdfwrite *wr, const sdfblend_quant *q);
+
+/* Convert and queue the next nrows rows, top to bottom. buf
+ * points at the first of them, in an interleaved sdfblend
+ * format, stride pixels apart. Blocks while the ring is full.
+ */
+int sdfwrite_rows(sdfwrite *wr,
+                  const void *buf,
+                  int format,
+                  int stride,
+                  int nrows);
+
+/* Flush, wait for the writer and close. Returns the first
+ * error seen since begin, or SDFWRITE_NOT_OK if fewer rows
+ * than the height were written.
+ */
+int sdfwrite_end(sdfwrite *wr);
+#endif
@@ -1,7 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -12,135 +12,66 @@
 
 #define SDF2D_SDFVM_PRIV
 #include "sdfvm.h"
+#include "sdfblend.h"
+#include "sdfrender.h"
+#include "sdfwrite.h"
+#include "sdfmap.h"
+#include "sdfvideo.h"
+#include "sdfbake.h"
 
 /* global feathering amount for hacky anti-aliasing */
 #define FEATHER_AMT 0.03
 
-typedef struct {
-    struct vec2 iResolution;
-    void *ud;
-    struct vec4 *region;
-} image_data;
+/* subsamples per pixel side at edges, 1 for none */
+#define AA_SAMPLES 4
+
+/* pixel format of the canvas, see sdfblend.h. SDFBLEND_RGB8
+ * draws straight into a mapped vmdemo.ppm
+ */
+#define CANVAS_FORMAT SDFBLEND_RGBF
 
 struct canvas {
-    struct vec3 *buf;
+    void *buf;
+    int format;
     struct vec2 res;
+    sdfrender *r;
 };
 
 typedef struct {
-    sdfvm vm;
     uint8_t *program;
     size_t sz;
     sdfvm_stacklet uniforms[16];
+    float lipschitz;
+    const struct sdf_field *fields;
+    int nfields;
 } user_params;
 
-#define US_MAXTHREADS 8
-
-typedef struct thread_userdata thread_userdata;
-
-typedef struct {
-    struct vec3 *buf;
-    image_data *data;
-    int off;
-    void (*draw)(struct vec3 *, struct vec2, thread_userdata *);
-    int stride;
-    sdfvm vm;
-} thread_data;
-
-struct thread_userdata {
-    thread_data *th;
-    image_data *data;
-};
-
-void *draw_thread(void *arg)
-{
-    thread_data *td;
-    image_data *data;
-    int x, y;
-    int w, h;
-    int stride;
-    struct vec3 *buf;
-    int nthreads;
-    int xstart, ystart;
-    int xend, yend;
-    int maxpos;
-    struct vec4 *reg;
-    thread_userdata thud;
-
-    td = arg;
-    data = td->data;
-    buf = td->buf;
-
-    w = data->iResolution.x;
-    h = data->iResolution.y;
-    stride = td->stride;
-    reg = data->region;
-
-    ystart = td->off + reg->y;
-    xstart = reg->x;
-    xend = reg->z + reg->x;
-    yend = reg->w + reg->y;
-
-    /* This is hard-coded for now */
-    nthreads = US_MAXTHREADS;
-
-    maxpos = w * h;
-
-    thud.th = td;
-    thud.data = data;
-    for (y = ystart; y < yend; y+=nthreads) {
-        for (x = xstart; x < xend; x++) {
-            int pos;
-            struct vec3 *c;
-            pos = y*stride + x;
-
-            if (pos > maxpos || pos < 0) continue;
-            c = &buf[pos];
-            td->draw(c, svec2(x - reg->x, y - reg->y), &thud);
-        }
-    }
-
-    return NULL;
-}
-
-void draw_with_stride(struct vec3 *buf,
-                      struct vec2 res,
-                      struct vec4 region,
-                      void (*drawfunc)(struct vec3 *, struct vec2, thread_userdata *),
-                      void *ud,
-                      int stride)
-{
-    thread_data td[US_MAXTHREADS];
-    pthread_t thread[US_MAXTHREADS];
-    int t;
-    image_data data;
-
-    data.iResolution = res;
-    data.ud = ud;
-    data.region = &region;
-
-    for (t = 0; t < US_MAXTHREADS; t++) {
-        td[t].buf = buf;
-        td[t].data = &data;
-        td[t].off = t;
-        td[t].draw = drawfunc;
-        td[t].stride = stride;
-        sdfvm_init(&td[t].vm);
-        pthread_create(&thread[t], NULL, draw_thread, &td[t]);
-    }
-
-    for (t = 0; t < US_MAXTHREADS; t++) {
-        pthread_join(thread[t], NULL);
-    }
-}
-
-void draw(struct vec3 *buf,
-          struct vec2 res,
+void draw(struct canvas *ctx,
           struct vec4 region,
-          void (*drawfunc)(struct vec3 *, struct vec2, thread_userdata *),
-          void *ud)
+          sdfrender_dist dist,
+          void *ud,
+          struct vec3 clr,
+          float feather,
+          float lipschitz)
 {
-    draw_with_stride(buf, res, region, drawfunc, ud, res.x);
+    sdfrender_draw dr;
+
+    sdfrender_draw_init(&dr);
+    dr.buf = ctx->buf;
+    dr.format = ctx->format;
+    dr.width = ctx->res.x;
+    dr.height = ctx->res.y;
+    dr.stride = ctx->res.x;
+    dr.region = region;
+    dr.dist = dist;
+    dr.ud = ud;
+    dr.clr = clr;
+    dr.feather = feather;
+    dr.scale = 2 / region.w;
+    dr.lipschitz = lipschitz;
+    dr.samples = AA_SAMPLES;
+
+    sdfrender_run(ctx->r, &dr);
 }
 
 struct vec3 rgb2color(int r, int g, int b)
@@ -149,56 +80,31 @@ struct vec3 rgb2color(int r, int g, int b)
     return svec3(r * scale, g * scale, b * scale);
 }
 
-static int mkcolor(float x)
-{
-    return floor(x * 255);
-}
-
-static void d_fill(struct vec3 *fragColor,
-                   struct vec2 fragCoord,
-                   thread_userdata *thud)
-{
-    image_data *id;
-    struct vec3 *col;
-    id = thud->data;
-
-    col = id->ud;
-    *fragColor = *col;
-}
-
 static void fill(struct canvas *ctx, struct vec3 clr)
 {
-    draw(ctx->buf, ctx->res, 
-         svec4(0, 0, ctx->res.x, ctx->res.y), 
-         d_fill, &clr);
+    sdfblend_fill_format(ctx->buf, ctx->format,
+                         ctx->res.x * ctx->res.y, clr);
 }
 
-static void write_ppm(struct vec3 *buf,
-                      struct vec2 res,
-                      const char *filename)
+static int write_ppm(void *buf,
+                     int format,
+                     struct vec2 res,
+                     const char *filename)
 {
-    int x, y;
-    FILE *fp;
-    unsigned char *ibuf;
-
-    fp = fopen(filename, "w");
-    fprintf(fp, "P6\n%d %d\n%d\n", (int)res.x, (int)res.y, 255);
-
-    ibuf = malloc(3 * res.y * res.x * sizeof(unsigned char));
-    for (y = 0; y < res.y; y++) {
-        for (x = 0; x < res.x; x++) {
-            int pos;
-            pos = y * res.x + x;
+    sdfwrite *wr;
+    int rc;
 
-            ibuf[3*pos] = mkcolor(buf[pos].x);
-            ibuf[3*pos + 1] = mkcolor(buf[pos].y);
-            ibuf[3*pos + 2] = mkcolor(buf[pos].z);
-        }
+    wr = malloc(sdfwrite_sizeof());
+    rc = sdfwrite_begin(wr, filename, res.x, res.y);
+    if (rc == SDFWRITE_OK) {
+        sdfwrite_rows(wr, buf, format, res.x, res.y);
+        rc = sdfwrite_end(wr);
     }
+    free(wr);
+
+    if (rc) fprintf(stderr, "could not write %s\n", filename);
 
-    fwrite(ibuf, 3 * res.y * res.x * sizeof(unsigned char), 1, fp);
-    free(ibuf);
-    fclose(fp);
+    return rc;
 }
 
 void draw_gridlines(struct canvas *ctx)
@@ -213,44 +119,41 @@ void draw_gridlines(struct canvas *ctx)
     size = w / 4;
 
     for (y = 0; y < h; y += size) {
-        for (x = 0; x < w; x++) {
-            int pos;
-            pos = y*w + x;
-            ctx->buf[pos] = svec3_zero();
-        }
+        sdfblend_fill_format(sdfblend_pixel(ctx->buf, ctx->format, y*w),
+                             ctx->format, w, svec3_zero());
     }
 
     for (x = 0; x < w; x += size) {
         for (y = 0; y < h; y++) {
-            int pos;
-            pos = y*w + x;
-            ctx->buf[pos] = svec3_zero();
+            void *px;
+            px = sdfblend_pixel(ctx->buf, ctx->format, y*w + x);
+            sdfblend_fill_format(px, ctx->format, 1, svec3_zero());
         }
     }
 
 }
 int error = 0;
-static void draw_color(sdfvm *vm,
+static float draw_dist(sdfvm *vm,
                        struct vec2 p,
-                       struct vec3 *fragColor,
                        uint8_t *program,
                        size_t sz,
                        sdfvm_stacklet *uniforms,
                        int nuniforms)
 {
-    struct vec3 col;
+    float d;
     int rc;
 
-    if (error) return;
+    /* outside: leave the pixel alone */
+    if (error) return 1.0;
 
     sdfvm_point_set(vm, p);
-    sdfvm_color_set(vm, *fragColor);
     sdfvm_uniforms(vm, uniforms, nuniforms);
     rc = sdfvm_execute(vm, program, sz);
 
     if (rc) {
         printf("error\n");
         error = 1;
+        return 1.0;
     }
 
 #if 0
@@ -273,44 +176,38 @@ static void draw_color(sdfvm *vm,
 
     sdfvm_push_scalar(vm, 0.1);
     sdfvm_lerp(vm);
-
-    sdfvm_push_scalar(vm, -1.0);
-    sdfvm_mul(vm);
-    sdfvm_gtz(vm);
-    sdfvm_push_vec3(vm, *fragColor);
-    sdfvm_push_vec3(vm, svec3_zero());
-    sdfvm_lerp3(vm);
 #endif
 
-    sdfvm_pop_vec3(vm, &col);
+    sdfvm_pop_scalar(vm, &d);
 
-    *fragColor = col;
+    return d;
 }
 
-static void d_polygon(struct vec3 *fragColor,
-                      struct vec2 st,
-                      thread_userdata *thud)
+static float d_polygon(struct vec2 st,
+                       const sdfrender_draw *dr,
+                       sdfrender_worker *w)
 {
     struct vec2 p;
-    image_data *id;
     struct vec2 res;
     sdfvm *vm;
     user_params *params;
 
-    id = thud->data;
-    vm = &thud->th->vm;
-    params = id->ud;
+    params = dr->ud;
+    vm = sdfrender_worker_vm(w);
+    if (vm == NULL) return 1.0;
+
+    sdfvm_fields(vm, params->fields, params->nfields);
 
-    res = svec2(id->region->z, id->region->w);
+    res = svec2(dr->region.z, dr->region.w);
     sdfvm_push_vec2(vm, svec2(st.x, st.y));
     sdfvm_push_vec2(vm, res);
     sdfvm_normalize(vm);
     sdfvm_pop_vec2(vm, &p);
     p.y = p.y*-1;
 
-    draw_color(vm, p, fragColor,
-            params->program, params->sz,
-            params->uniforms, 16);
+    return draw_dist(vm, p,
+                     params->program, params->sz,
+                     params->uniforms, 16);
 }
 
 void polygon(struct canvas *ctx,
@@ -318,7 +215,9 @@ void polygon(struct canvas *ctx,
            float w, float h,
            user_params *p)
 {
-    draw(ctx->buf, ctx->res, svec4(x, y, w, h), d_polygon, p);
+    /* hard edge, the program output is a plain distance */
+    draw(ctx, svec4(x, y, w, h), d_polygon, p, svec3_zero(), 0,
+         p->lipschitz);
 }
 
 static int add_float(uint8_t *prog, size_t *ppos, size_t maxsz, float val)
@@ -426,19 +325,6 @@ void generate_program(uint8_t *prog, size_t *sz, size_t maxsz)
 
     prog[pos++] = SDF_OP_ADD;
 
-    prog[pos++] = SDF_OP_SCALAR;
-    add_float(prog, &pos, maxsz, -1.0);
-    prog[pos++] = SDF_OP_MUL;
-
-    prog[pos++] = SDF_OP_GTZ;
-
-    prog[pos++] = SDF_OP_COLOR;
-    prog[pos++] = SDF_OP_VEC3;
-    add_float(prog, &pos, maxsz, 0.0);
-    add_float(prog, &pos, maxsz, 0.0);
-    add_float(prog, &pos, maxsz, 0.0);
-    prog[pos++] = SDF_OP_LERP3;
-
     *sz = pos;
 }
 
@@ -477,16 +363,162 @@ void update_uniforms(sdfvm_stacklet *r)
     r[6].data.s = 0.7;
 }
 
+/* "vmdemo y4m" or "vmdemo rgb" streams this many frames to stdout */
+#define NFRAMES 60
+#define FPS 30
+
+/* sweep the circleness, drawing each frame while the last is written */
+static int animate(struct canvas *ctx, user_params *params, int type)
+{
+    sdfvideo *v;
+    int rc;
+    int i;
+
+    v = malloc(sdfvideo_sizeof());
+    if (v == NULL) {
+        fprintf(stderr, "could not allocate the video stream\n");
+        return SDFVIDEO_NOT_OK;
+    }
+
+    rc = sdfvideo_open(v, 1, type, ctx->res.x, ctx->res.y,
+                       ctx->format, FPS, 1);
+
+    if (rc) {
+        free(v);
+        fprintf(stderr, "could not start the video stream\n");
+        return rc;
+    }
+
+    for (i = 0; rc == SDFVIDEO_OK && i < NFRAMES; i++) {
+        params->uniforms[4].data.s = 0.5 - 0.5 * cos(2 * M_PI * i / NFRAMES);
+        sdfvm_lipschitz(params->program, params->sz,
+                        params->uniforms, 16, &params->lipschitz);
+
+        ctx->buf = sdfvideo_canvas(v);
+        fill(ctx, svec3(1., 1.0, 1.0));
+        polygon(ctx, 0, 0, ctx->res.x, ctx->res.y, params);
+        rc = sdfvideo_submit(v);
+    }
+
+    if (sdfvideo_close(v) && rc == SDFVIDEO_OK) rc = SDFVIDEO_IO;
+    free(v);
+
+    if (rc) fprintf(stderr, "could not write the frames\n");
+
+    return rc;
+}
+
+/* "vmdemo bake" bakes the program on square grids from
+ * BAKE_MIN to BAKE_MAX samples a side, reporting the error of
+ * each, and draws the BAKE_DRAW one into vmdemo_bake.ppm
+ */
+#define BAKE_MIN 16
+#define BAKE_MAX 256
+#define BAKE_DRAW 64
+
+/* grid past the [-1, 1] the program is drawn over */
+#define BAKE_MARGIN 0.1
+
+static int bake_grid(struct sdf_field *f,
+                     sdfvm *vm,
+                     user_params *params,
+                     int n)
+{
+    float e;
+
+    e = 1 + BAKE_MARGIN;
+
+    if (sdfbake_init(f, n, n, svec2(-e, -e), svec2(e, e))) return 1;
+
+    if (sdfbake_program(f, vm, params->program, params->sz)) {
+        sdfbake_clean(f);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int bake(struct canvas *ctx, user_params *params)
+{
+    struct sdf_field f;
+    sdfvm *vm;
+    user_params baked;
+    uint8_t prog[8];
+    size_t sz;
+    int n;
+    int rc;
+
+    vm = malloc(sdfvm_sizeof());
+    sdfvm_init(vm);
+    sdfvm_uniforms(vm, params->uniforms, 16);
+
+    rc = 0;
+
+    fprintf(stderr, "grid        max      rms      edge max edge rms\n");
+
+    for (n = BAKE_MIN; !rc && n <= BAKE_MAX; n *= 2) {
+        sdfbake_error err;
+
+        rc = bake_grid(&f, vm, params, n);
+        if (rc) break;
+
+        /* edge: within a pixel, the region is 2 units tall */
+        rc = sdfbake_check_program(&f, vm, params->program, params->sz,
+                                   4, 2 / ctx->res.y, &err);
+        if (!rc) {
+            fprintf(stderr, "%4d x %-4d %.6f %.6f %.6f %.6f\n",
+                    n, n, err.max, err.rms, err.edge_max, err.edge_rms);
+        }
+
+        sdfbake_clean(&f);
+    }
+
+    if (!rc) rc = bake_grid(&f, vm, params, BAKE_DRAW);
+
+    if (!rc) {
+        /* point, field 0 */
+        sz = 0;
+        prog[sz++] = SDF_OP_POINT;
+        prog[sz++] = SDF_OP_SCALAR;
+        add_float(prog, &sz, sizeof(prog), 0);
+        prog[sz++] = SDF_OP_FIELD;
+
+        baked = *params;
+        baked.program = prog;
+        baked.sz = sz;
+        baked.fields = &f;
+        baked.nfields = 1;
+        baked.lipschitz = f.lipschitz;
+
+        ctx->buf = malloc(ctx->res.x * ctx->res.y *
+                          sdfblend_pixsize(ctx->format));
+        fill(ctx, svec3(1., 1.0, 1.0));
+        polygon(ctx, 0, 0, ctx->res.x, ctx->res.y, &baked);
+        rc = write_ppm(ctx->buf, ctx->format, ctx->res, "vmdemo_bake.ppm");
+        free(ctx->buf);
+        ctx->buf = NULL;
+
+        sdfbake_clean(&f);
+    }
+
+    free(vm);
+
+    if (rc) fprintf(stderr, "could not bake the program\n");
+
+    return rc;
+}
+
 #define PROGSZ 256
 int main(int argc, char *argv[])
 {
-    struct vec3 *buf;
+    void *buf;
     int width, height;
     struct vec2 res;
     struct canvas ctx;
     int sz;
     int clrpos;
     user_params params;
+    sdfmap *map;
 
     /* rainbow colors:
      * Red: 255, 179, 186
@@ -504,26 +536,74 @@ int main(int argc, char *argv[])
 
     res = svec2(width, height);
 
-    buf = malloc(width * height * sizeof(struct vec3));
-
     ctx.res = res;
-    ctx.buf = buf;
+    ctx.buf = NULL;
+    ctx.format = CANVAS_FORMAT;
+    ctx.r = malloc(sdfrender_sizeof());
+    if (sdfrender_init(ctx.r, SDFRENDER_AUTO, SDFRENDER_PIN)) {
+        fprintf(stderr, "could not start render threads\n");
+        return 1;
+    }
 
-    sdfvm_init(&params.vm);
     params.program = calloc(1, PROGSZ);
     params.sz = 0;
     generate_program(params.program, &params.sz, PROGSZ);
     update_uniforms(params.uniforms);
+    params.fields = NULL;
+    params.nfields = 0;
+
+    if (argc > 1) {
+        int rc;
+        rc = 1;
+        if (!strcmp(argv[1], "y4m")) {
+            rc = animate(&ctx, &params, SDFVIDEO_Y4M);
+        } else if (!strcmp(argv[1], "rgb")) {
+            rc = animate(&ctx, &params, SDFVIDEO_RGB);
+        } else if (!strcmp(argv[1], "bake")) {
+            rc = bake(&ctx, &params);
+        } else {
+            fprintf(stderr, "usage: %s [y4m | rgb | bake]\n", argv[0]);
+        }
+        sdfrender_clean(ctx.r);
+        free(ctx.r);
+        free(params.program);
+        return rc;
+    }
+
+    map = NULL;
+    if (CANVAS_FORMAT == SDFBLEND_RGB8) {
+        map = malloc(sdfmap_sizeof());
+        if (sdfmap_open(map, "vmdemo.ppm", width, height, CANVAS_FORMAT)) {
+            free(map);
+            map = NULL;
+        }
+    }
+
+    if (map != NULL) buf = sdfmap_pixels(map);
+    else buf = malloc(width * height * sdfblend_pixsize(CANVAS_FORMAT));
+
+    ctx.buf = buf;
+
+    /* zero, and so no culling, if the program has no bound */
+    sdfvm_lipschitz(params.program, params.sz,
+                    params.uniforms, 16, &params.lipschitz);
 
     fill(&ctx, svec3(1., 1.0, 1.0));
     polygon(&ctx, 0, 0, sz, sz, &params);
     clrpos = (clrpos + 1) % 5;
 
-    write_ppm(buf, res, "vmdemo.ppm");
+    if (map != NULL) {
+        if (sdfmap_close(map)) fprintf(stderr, "could not write vmdemo.ppm\n");
+        free(map);
+    } else {
+        write_ppm(buf, CANVAS_FORMAT, res, "vmdemo.ppm");
+        free(buf);
+    }
 
     /* sdfvm_print_lookup_table(NULL); */
 
-    free(buf);
+    sdfrender_clean(ctx.r);
+    free(ctx.r);
     free(params.program);
     return 0;
 }